@@ -0,0 +1,519 @@
+/// Benchmark suite for bigint, matrix, permutation and geometry. Build and run from the repository root:
+///
+///     g++ -std=c++17 -O2 -march=native -pthread benchmark.cpp -o benchmark
+///     ./benchmark [--filter=substring] [--min-time=seconds] [--counters] > results.json
+///
+/// Every case is run with a growing number of iterations until one run takes at least --min-time
+/// (0.5 s by default); that run is reported as JSON with ns/op and heap allocations/op. --counters adds
+/// cycles, instructions, cache misses and branch misses per op from perf_event_open where the kernel allows it.
+
+#define CPP_NO_MAIN
+#include "bigint.cpp"
+#include "matrix.cpp"
+#include "permutation.cpp"
+#include "geometry/geometry.h"
+
+#include <atomic>       // for the allocation counter
+#include <chrono>
+#include <cstddef>      // for std::max_align_t
+#include <cstdio>
+#include <cstdlib>      // for std::malloc and std::free
+#include <ctime>        // for the date in the report context
+#include <new>
+#include <numeric>      // for std::iota
+#include <random>
+#include <sstream>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+/// Every heap allocation in the process goes through these, so a case reports how many it made per op
+std::atomic<uint64_t> allocation_count(0);
+
+void* counted_allocate(size_t size, size_t alignment) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void* res = nullptr;
+    if (alignment <= alignof(std::max_align_t)) {
+        res = std::malloc(size ? size : 1);
+    } else if (posix_memalign(&res, alignment, size ? size : 1) != 0) {
+        res = nullptr;
+    }
+    if (res == nullptr) { throw std::bad_alloc(); }
+    return res;
+}
+
+void* operator new(size_t size) { return counted_allocate(size, 0); }
+void* operator new[](size_t size) { return counted_allocate(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment) { return counted_allocate(size, static_cast<size_t>(alignment)); }
+void* operator new[](size_t size, std::align_val_t alignment) { return counted_allocate(size, static_cast<size_t>(alignment)); }
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { std::free(pointer); }
+
+
+/// Hardware counters of this thread through perf_event_open, user space only. Unavailable outside Linux
+/// and when perf_event_paranoid or a sandbox forbids them.
+class hardware_counters {
+public:
+    static constexpr size_t COUNT = 4;
+
+    hardware_counters() {
+        _fds.fill(-1);
+#if defined(__linux__)
+        const uint64_t configs[COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                         PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        for (size_t i = 0; i < COUNT; ++i) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            _fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+    }
+
+    hardware_counters(const hardware_counters& other) = delete;
+    hardware_counters& operator=(const hardware_counters& other) = delete;
+
+    ~hardware_counters() {
+#if defined(__linux__)
+        for (int fd : _fds) {
+            if (fd >= 0) { close(fd); }
+        }
+#endif
+    }
+
+    bool available() const {
+        for (int fd : _fds) {
+            if (fd < 0) { return false; }
+        }
+        return true;
+    }
+
+    static const char* name(size_t i) {
+        static const char* names[COUNT] = {"cycles", "instructions", "cache_misses", "branch_misses"};
+        return names[i];
+    }
+
+    void start() {
+#if defined(__linux__)
+        for (int fd : _fds) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    std::array<uint64_t, COUNT> stop() {
+        std::array<uint64_t, COUNT> res {};
+#if defined(__linux__)
+        for (size_t i = 0; i < COUNT; ++i) {
+            ioctl(_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(_fds[i], &res[i], sizeof(res[i])) != sizeof(res[i])) { res[i] = 0; }
+        }
+#endif
+        return res;
+    }
+
+private:
+    std::array<int, COUNT> _fds;
+};
+
+
+/// Keeps the compiler from dropping a computation whose result is otherwise unused
+template<typename T>
+void do_not_optimize(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/// Passed to a case: `while (state.keep_running()) { ... }` runs the measured operation the chosen number
+/// of times. Only the loop is measured; the setup before it is not.
+class benchmark_state {
+public:
+    benchmark_state(size_t size, uint64_t iterations, hardware_counters* counters):
+        _size(size), _remaining(iterations), _started(false), _counters(counters),
+        _elapsed(0), _allocations(0), _counted {} {}
+
+    size_t size() const { return _size; }
+
+    bool keep_running() {
+        if (_remaining == 0) {
+            stop();
+            return false;
+        }
+        if (!_started) { start(); }
+        --_remaining;
+        return true;
+    }
+
+    double elapsed() const { return _elapsed; }
+    uint64_t allocations() const { return _allocations; }
+    const std::array<uint64_t, hardware_counters::COUNT>& counted() const { return _counted; }
+
+private:
+    void start() {
+        _started = true;
+        _allocations = allocation_count.load(std::memory_order_relaxed);
+        if (_counters != nullptr) { _counters->start(); }
+        _start = std::chrono::steady_clock::now();
+    }
+
+    void stop() {
+        _elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+        if (_counters != nullptr) { _counted = _counters->stop(); }
+        _allocations = allocation_count.load(std::memory_order_relaxed) - _allocations;
+    }
+
+    size_t _size;
+    uint64_t _remaining;
+    bool _started;
+    hardware_counters* _counters;
+    std::chrono::steady_clock::time_point _start;
+    double _elapsed;
+    uint64_t _allocations;
+    std::array<uint64_t, hardware_counters::COUNT> _counted;
+};
+
+struct benchmark_case {
+    std::string name;
+    size_t size;
+    std::function<void(benchmark_state&)> run;
+};
+
+struct benchmark_result {
+    std::string name;
+    uint64_t iterations;
+    double ns_per_op;
+    double allocations_per_op;
+    bool has_counters;
+    std::array<double, hardware_counters::COUNT> counters_per_op;
+};
+
+std::vector<benchmark_case>& benchmark_registry() {
+    static std::vector<benchmark_case> cases;
+    return cases;
+}
+
+void register_benchmark(const std::string& name, std::initializer_list<size_t> sizes, std::function<void(benchmark_state&)> run) {
+    for (size_t size : sizes) {
+        benchmark_registry().push_back(benchmark_case {name + "/" + std::to_string(size), size, run});
+    }
+}
+
+benchmark_result run_benchmark(const benchmark_case& current, double min_time, hardware_counters* counters) {
+    uint64_t iterations = 1;
+    while (true) {
+        benchmark_state state(current.size, iterations, counters);
+        current.run(state);
+        double elapsed = state.elapsed();
+
+        if (elapsed >= min_time || iterations >= (uint64_t(1) << 40)) {
+            benchmark_result res {current.name, iterations, elapsed * 1e9 / iterations,
+                                  static_cast<double>(state.allocations()) / iterations, counters != nullptr, {}};
+            for (size_t i = 0; i < hardware_counters::COUNT; ++i) {
+                res.counters_per_op[i] = static_cast<double>(state.counted()[i]) / iterations;
+            }
+            return res;
+        }
+
+        double grow = elapsed > 0 ? 1.4 * min_time / elapsed : 100;
+        iterations = static_cast<uint64_t>(iterations * std::min(100., std::max(2., grow)));
+    }
+}
+
+void print_json(const std::vector<benchmark_result>& results, double min_time) {
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    std::printf("{\n  \"context\": {\"date\": \"%s\", \"min_time\": %g, \"threads\": %u},\n  \"benchmarks\": [\n",
+                date, min_time, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < results.size(); ++i) {
+        const benchmark_result& res = results[i];
+        std::printf("    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"allocations_per_op\": %.3f",
+                    res.name.c_str(), static_cast<unsigned long long>(res.iterations), res.ns_per_op, res.allocations_per_op);
+        if (res.has_counters) {
+            std::printf(", \"counters_per_op\": {");
+            for (size_t j = 0; j < hardware_counters::COUNT; ++j) {
+                std::printf("%s\"%s\": %.3f", j ? ", " : "", hardware_counters::name(j), res.counters_per_op[j]);
+            }
+            std::printf("}");
+        }
+        std::printf("}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ]\n}\n");
+}
+
+
+std::string random_digits(size_t count, std::mt19937_64& random) {
+    std::string res(count, '0');
+    for (auto& digit : res) {
+        digit = static_cast<char>('0' + random() % 10);
+    }
+    res[0] = static_cast<char>('1' + random() % 9);
+    return res;
+}
+
+bigint random_bigint(size_t digits, std::mt19937_64& random) {
+    bigint res;
+    std::istringstream(random_digits(digits, random)) >> res;
+    return res;
+}
+
+template<typename vt, size_t height, size_t width>
+matrix<vt, height, width> random_matrix(std::mt19937_64& random) {
+    std::uniform_real_distribution<vt> values(-1, 1);
+    matrix<vt, height, width> res;
+    for (size_t i = 0; i < height; ++i) {
+        for (size_t j = 0; j < width; ++j) {
+            res.at(i, j) = values(random);
+        }
+    }
+    return res;
+}
+
+template<size_t length>
+permutation<length> random_permutation(std::mt19937_64& random) {
+    std::vector<unsigned> values(length);
+    for (size_t i = 0; i < length; ++i) { values[i] = i; }
+    std::shuffle(values.begin(), values.end(), random);
+    return permutation<length>(values.data());
+}
+
+/// A star-shaped polygon: vertices at random distances around the origin
+polygon random_polygon(size_t count, std::mt19937_64& random) {
+    std::uniform_real_distribution<double> radius(0.5, 1);
+    std::vector<vector> points(count);
+    for (size_t i = 0; i < count; ++i) {
+        double angle = 2 * pi() * i / count, r = 100 * radius(random);
+        points[i] = vector(r * std::cos(angle), r * std::sin(angle));
+    }
+    return polygon(points);
+}
+
+template<size_t n>
+void register_matrix_benchmarks() {
+    register_benchmark("matrix/mul", {n}, [](benchmark_state& state) {
+        std::mt19937_64 random(n);
+        auto a = random_matrix<double, n, n>(random), b = random_matrix<double, n, n>(random);
+        while (state.keep_running()) {
+            auto c = a * b;
+            do_not_optimize(c.data()[0]);
+        }
+    });
+    register_benchmark("matrix/transpose", {n}, [](benchmark_state& state) {
+        std::mt19937_64 random(n);
+        auto a = random_matrix<double, n, n>(random);
+        while (state.keep_running()) {
+            auto t = a.transposed();
+            do_not_optimize(t.data()[0]);
+        }
+    });
+}
+
+template<size_t n>
+void register_det_benchmark() {
+    register_benchmark("matrix/det", {n}, [](benchmark_state& state) {
+        std::mt19937_64 random(n);
+        auto a = random_matrix<double, n, n>(random);
+        while (state.keep_running()) {
+            do_not_optimize(a.det());
+        }
+    });
+}
+
+template<size_t n>
+void register_permutation_benchmarks() {
+    register_benchmark("permutation/compose", {n}, [](benchmark_state& state) {
+        std::mt19937_64 random(n);
+        auto a = random_permutation<n>(random), b = random_permutation<n>(random);
+        while (state.keep_running()) {
+            a *= b;
+            do_not_optimize(a);
+        }
+    });
+    register_benchmark("permutation/next", {n}, [](benchmark_state& state) {
+        std::mt19937_64 random(n);
+        auto a = random_permutation<n>(random);
+        while (state.keep_running()) {
+            ++a;
+            do_not_optimize(a);
+        }
+    });
+    register_benchmark("permutation/inverse", {n}, [](benchmark_state& state) {
+        std::mt19937_64 random(n);
+        auto a = random_permutation<n>(random);
+        while (state.keep_running()) {
+            auto b = a.inverse();
+            do_not_optimize(b);
+        }
+    });
+}
+
+/// Naive scatter and gather against the blocked kernels on permutations far larger than the caches.
+/// `run(lhs, rhs, out, count, scratch)` gets room for 2 * count pairs that stays allocated across runs.
+template<typename kernel>
+void register_huge_permutation_benchmark(const std::string& name, kernel run) {
+    typedef dynamic_permutation::index_type index_type;
+    register_benchmark(name, {1 << 16, 1 << 20, 1 << 22, 1 << 24}, [run](benchmark_state& state) {
+        size_t count = state.size();
+        std::mt19937_64 random(count);
+        std::vector<index_type> lhs(count), rhs(count), out(count);
+        std::iota(lhs.begin(), lhs.end(), 0);
+        std::iota(rhs.begin(), rhs.end(), 0);
+        std::shuffle(lhs.begin(), lhs.end(), random);
+        std::shuffle(rhs.begin(), rhs.end(), random);
+        std::unique_ptr<index_pair<index_type>[]> scratch(new index_pair<index_type>[2 * count]);
+        while (state.keep_running()) {
+            run(lhs.data(), rhs.data(), out.data(), count, scratch.get());
+            do_not_optimize(out[0]);
+        }
+    });
+}
+
+void register_huge_permutation_benchmarks() {
+    typedef dynamic_permutation::index_type index_type;
+    typedef index_pair<index_type> pair;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+    register_huge_permutation_benchmark("permutation/huge_inverse_naive", [](const index_type* lhs, const index_type*, index_type* out, size_t count, pair*) {
+        invert_indices(lhs, out, count);
+    });
+    register_huge_permutation_benchmark("permutation/huge_inverse_blocked", [](const index_type* lhs, const index_type*, index_type* out, size_t count, pair*) {
+        invert_indices_blocked(lhs, out, count);
+    });
+    register_huge_permutation_benchmark("permutation/huge_inverse_blocked_scratch", [threads](const index_type* lhs, const index_type*, index_type* out, size_t count, pair* scratch) {
+        invert_indices_blocked(lhs, out, count, threads, scratch);
+    });
+    register_huge_permutation_benchmark("permutation/huge_compose_naive", [](const index_type* lhs, const index_type* rhs, index_type* out, size_t count, pair*) {
+        compose_indices(lhs, rhs, out, count);
+    });
+    register_huge_permutation_benchmark("permutation/huge_compose_blocked", [](const index_type* lhs, const index_type* rhs, index_type* out, size_t count, pair*) {
+        compose_indices_blocked(lhs, rhs, out, count);
+    });
+    register_huge_permutation_benchmark("permutation/huge_compose_blocked_scratch", [threads](const index_type* lhs, const index_type* rhs, index_type* out, size_t count, pair* scratch) {
+        compose_indices_blocked(lhs, rhs, out, count, threads, scratch);
+    });
+}
+
+void register_benchmarks() {
+    register_benchmark("bigint/add", {64, 512, 4096}, [](benchmark_state& state) {
+        std::mt19937_64 random(state.size());
+        bigint a = random_bigint(state.size(), random), b = random_bigint(state.size(), random);
+        while (state.keep_running()) {
+            bigint c = a + b;
+            do_not_optimize(c);
+        }
+    });
+    register_benchmark("bigint/mul", {64, 512, 4096}, [](benchmark_state& state) {
+        std::mt19937_64 random(state.size());
+        bigint a = random_bigint(state.size(), random), b = random_bigint(state.size(), random);
+        while (state.keep_running()) {
+            bigint c = a * b;
+            do_not_optimize(c);
+        }
+    });
+    register_benchmark("bigint/parse", {64, 512, 4096}, [](benchmark_state& state) {
+        std::mt19937_64 random(state.size());
+        std::string digits = random_digits(state.size(), random);
+        while (state.keep_running()) {
+            bigint a;
+            std::istringstream(digits) >> a;
+            do_not_optimize(a);
+        }
+    });
+    register_benchmark("bigint/print", {64, 512, 4096}, [](benchmark_state& state) {
+        std::mt19937_64 random(state.size());
+        bigint a = random_bigint(state.size(), random);
+        while (state.keep_running()) {
+            std::string digits = a.to_string();
+            do_not_optimize(digits);
+        }
+    });
+
+    register_matrix_benchmarks<4>();
+    register_matrix_benchmarks<16>();
+    register_matrix_benchmarks<64>();
+    register_det_benchmark<4>();
+    register_det_benchmark<6>();
+    register_det_benchmark<8>();
+
+    register_permutation_benchmarks<8>();
+    register_permutation_benchmarks<64>();
+    register_permutation_benchmarks<1024>();
+    register_huge_permutation_benchmarks();
+
+    // The translation drops the cached metrics, so every area() walks the vertices again
+    register_benchmark("polygon/area", {16, 1024, 65536}, [](benchmark_state& state) {
+        std::mt19937_64 random(state.size());
+        polygon p = random_polygon(state.size(), random);
+        while (state.keep_running()) {
+            p.translate(vector(1e-9, 0));
+            do_not_optimize(p.area());
+        }
+    });
+    register_benchmark("polygon/congruence", {16, 1024, 65536}, [](benchmark_state& state) {
+        std::mt19937_64 random(state.size());
+        polygon p = random_polygon(state.size(), random), q = p;
+        q.rotate(1);
+        q.translate(vector(5, -3));
+        while (state.keep_running()) {
+            do_not_optimize(p.congruent_to(q));
+        }
+    });
+}
+
+
+int main(int argc, char** argv) {
+    std::string filter;
+    double min_time = 0.5;
+    bool with_counters = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--filter=", 0) == 0) {
+            filter = arg.substr(9);
+        } else if (arg.rfind("--min-time=", 0) == 0) {
+            min_time = std::stod(arg.substr(11));
+        } else if (arg == "--counters") {
+            with_counters = true;
+        } else {
+            std::cerr << "Error: unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    std::unique_ptr<hardware_counters> counters;
+    if (with_counters) {
+        counters.reset(new hardware_counters());
+        if (!counters->available()) {
+            std::cerr << "Hardware counters are not available, reporting without them" << std::endl;
+            counters.reset();
+        }
+    }
+
+    register_benchmarks();
+    std::vector<benchmark_result> results;
+    for (auto& current : benchmark_registry()) {
+        if (current.name.find(filter) == std::string::npos) { continue; }
+        std::cerr << current.name << std::endl;
+        results.push_back(run_benchmark(current, min_time, counters.get()));
+    }
+
+    print_json(results, min_time);
+    return 0;
+}
@@ -240,6 +240,7 @@ std::ostream& operator<<(std::ostream& os, const bigint& num) {
     return os;
 }
 
+#ifndef CPP_NO_MAIN
 int main() {
 //    bigint x;
 //    std::cin >> x;
@@ -273,3 +274,4 @@ int main() {
 
     return 0;
 }
+#endif //CPP_NO_MAIN
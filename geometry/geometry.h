@@ -2,9 +2,13 @@
 #define CPP_GEOMETRY_H
 
 #include "vector.h"
+#include "point_array.h"
 #include <vector>
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstring>      // for std::memcpy
+#include <functional>   // for std::hash
 
 constexpr double pi() { return std::atan(1) * 4; }
 
@@ -12,7 +16,64 @@ size_t mod(const size_t& a, const size_t& b) {
     return (a % b + b) % b;
 }
 
+/// Distance from `point` to the segment [a, b]
+double segment_distance(const vector& point, const vector& a, const vector& b) {
+    vector ab = b - a;
+    double len2 = dot_product(ab, ab);
+    if (len2 == 0) { return (point - a).length(); }
+
+    double t = std::max(0., std::min(1., dot_product(point - a, ab) / len2));
+    return (point - (a + ab * t)).length();
+}
+
+/// Axis-aligned bounding box
+struct box {
+    /// The empty box: it contains and intersects nothing, is infinitely far away and merges to the other box
+    box(): lo(INFINITY, INFINITY), hi(-INFINITY, -INFINITY) {}
+    box(const vector& lo, const vector& hi): lo(lo), hi(hi) {}
+
+    bool empty() const { return lo.x > hi.x || lo.y > hi.y; }
+
+    double area() const { return empty() ? 0 : (hi.x - lo.x) * (hi.y - lo.y); }
+    vector center() const { return (lo + hi) / 2.0; }
+
+    bool contains(const vector& point) const {
+        return lo.x <= point.x && point.x <= hi.x && lo.y <= point.y && point.y <= hi.y;
+    }
+
+    bool intersects(const box& other) const {
+        return lo.x <= other.hi.x && other.lo.x <= hi.x && lo.y <= other.hi.y && other.lo.y <= hi.y;
+    }
+
+    /// Smallest box covering both
+    box merged(const box& other) const {
+        return box(vector(std::min(lo.x, other.lo.x), std::min(lo.y, other.lo.y)),
+                   vector(std::max(hi.x, other.hi.x), std::max(hi.y, other.hi.y)));
+    }
+
+    /// Distance from `point` to the closest point of the box, 0 inside
+    double distance(const vector& point) const {
+        double dx = std::max(0., std::max(lo.x - point.x, point.x - hi.x));
+        double dy = std::max(0., std::max(lo.y - point.y, point.y - hi.y));
+        return std::sqrt(dx * dx + dy * dy);
+    }
+
+    vector lo;
+    vector hi;
+};
+
+/// Decided by the turn at the lowest vertex, which is convex in a simple polygon, so the answer is exact.
+/// The sign of the area is the fallback when that turn is degenerate.
 bool is_clockwise(const std::vector<vector>& coords) {
+    size_t k = coords.size(), lowest = 0;
+    for (size_t i = 1; i < k; ++i) {
+        if (coords[i].y < coords[lowest].y || (coords[i].y == coords[lowest].y && coords[i].x < coords[lowest].x)) { lowest = i; }
+    }
+    if (k >= 3) {
+        int turn = orientation(coords[lowest ? lowest - 1 : k - 1], coords[lowest], coords[lowest + 1 == k ? 0 : lowest + 1]);
+        if (turn != 0) { return turn < 0; }
+    }
+
     double sum = 0;
     for (size_t i = 0; i < coords.size(); ++i) {
         size_t k = coords.size();
@@ -21,6 +82,86 @@ bool is_clockwise(const std::vector<vector>& coords) {
     return sum > 0;
 }
 
+/// Side length and turn at one polygon vertex: the side from this vertex to the next one, and the sine and
+/// cosine of the angle between the incoming and that side. Rigid motions keep the sequence up to a cyclic shift.
+struct vertex_signature {
+    double length;
+    double sin_turn;
+    double cos_turn;
+};
+
+bool operator== (const vertex_signature& first, const vertex_signature& second) {
+    return equal(first.length, second.length) && equal(first.sin_turn, second.sin_turn) && equal(first.cos_turn, second.cos_turn);
+}
+
+/// `lengths[i]` is the length of the side from points[i] to points[i + 1]
+std::vector<vertex_signature> signature(const point_array& points, const std::vector<double>& lengths) {
+    size_t k = points.size();
+    std::vector<vertex_signature> res(k);
+
+    for (size_t i = 0; i < k; ++i) {
+        size_t prev = i ? i - 1 : k - 1;
+        vector in = points[i] - points[prev];
+        vector out = points[i + 1] - points[i];
+        double norm = lengths[prev] * lengths[i];
+
+        res[i].length = lengths[i];
+        res[i].sin_turn = norm ? cross_product(in, out) / norm : 0;
+        res[i].cos_turn = norm ? dot_product(in, out) / norm : 0;
+    }
+
+    return res;
+}
+
+/// True if `text` is `pattern` rotated by some shift. KMP over text doubled, O(k).
+/// Equality is up to EPS, which is not transitive, so near-degenerate inputs may be misjudged.
+template<typename T>
+bool is_cyclic_shift(const std::vector<T>& pattern, const std::vector<T>& text) {
+    size_t k = pattern.size();
+    if (k != text.size()) { return false; }
+    if (k == 0) { return true; }
+
+    std::vector<size_t> failure(k, 0);
+    for (size_t i = 1, matched = 0; i < k; ++i) {
+        while (matched > 0 && !(pattern[i] == pattern[matched])) { matched = failure[matched - 1]; }
+        if (pattern[i] == pattern[matched]) { ++matched; }
+        failure[i] = matched;
+    }
+
+    for (size_t i = 0, matched = 0; i + 1 < 2 * k; ++i) {
+        const T& current = text[i % k];
+        while (matched > 0 && !(current == pattern[matched])) { matched = failure[matched - 1]; }
+        if (current == pattern[matched]) { ++matched; }
+        if (matched == k) { return true; }
+    }
+
+    return false;
+}
+
+/// Grid step for hashing coordinates. Points equal up to EPS fall into the same cell unless they straddle
+/// a cell border, which happens for about one pair in HASH_STEP / (2 * EPS).
+const double HASH_STEP = 1024 * EPS;
+
+/// Bits of the cell index, kept as a double: converting it to an integer would overflow for large
+/// coordinates. Adding 0 turns -0 into +0, so both land in the same cell.
+uint64_t hash_cell(double coordinate) {
+    double cell = std::floor(coordinate / HASH_STEP) + 0.;
+    uint64_t res;
+    std::memcpy(&res, &cell, sizeof(res));
+    return res;
+}
+
+size_t hash_value(const vector& point) {
+    uint64_t h = hash_cell(point.x) * 0x9e3779b97f4a7c15ULL;
+    h ^= hash_cell(point.y);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+}
+
 class shape {
 public:
     virtual ~shape () = default;
@@ -30,6 +171,12 @@ public:
     virtual double area() const = 0;
     virtual bool congruent_to(const shape& another) const = 0;
 
+    virtual box bounding_box() const = 0;
+    /// Exact for every shape: points on the boundary are contained, with no EPS tolerance
+    virtual bool contains(const vector& point) const = 0;
+    /// A rounded measurement; exactly 0 for contained points
+    virtual double distance(const vector& point) const = 0;
+
     virtual bool operator==(const shape& another) const = 0;
     virtual bool operator!=(const shape& another) const = 0;
 
@@ -51,6 +198,17 @@ public:
 
     double area() const override { return pi() * _radius * _radius; }
 
+    box bounding_box() const override {
+        return box(_center - vector(_radius, _radius), _center + vector(_radius, _radius));
+    }
+
+    bool contains(const vector& point) const override { return circle_side(_center, _radius, point) <= 0; }
+
+    double distance(const vector& point) const override {
+        if (contains(point)) { return 0; }
+        return std::max(0., (point - _center).length() - _radius);
+    }
+
     bool congruent_to(const shape& another) const override { return false; }
 
     bool congruent_to(const circle& another) const {
@@ -87,163 +245,200 @@ public:
     polygon() = default;
 
     polygon(const std::vector<vector>& points): _points(points) {
-        if (is_clockwise(_points)) { std::reverse(_points.begin(), _points.end()); }
+        if (is_clockwise(points)) { _points.reverse(); }
     }
 
     polygon(const polygon& other) = default;
     polygon& operator=(const polygon& other) = default;
     ~polygon() = default;
 
-    vector center() const override {
-        vector C(0, 0);
+    vector center() const override { return metrics()._centroid; }
 
-        for (size_t i = 0; i <= _points.size() - 1; ++i) {
-            size_t k = _points.size();
-            C.x += (_points[i].x + _points[(i + 1) % k].x) * cross_product(_points[i], _points[(i + 1) % k]);
-            C.y += (_points[i].y + _points[(i + 1) % k].y) * cross_product(_points[i], _points[(i + 1) % k]);
-        }
+    double perimeter() const override { return metrics()._perimeter; }
 
-        double A = area();
-        C.x = C.x / (6 * A);
-        C.y = C.y / (6 * A);
+    double area() const override { return metrics()._area; }
 
-        return C;
-    }
+    /// edge_lengths()[i] is the length of the side from vertex i to vertex i + 1
+    const std::vector<double>& edge_lengths() const { return metrics()._edge_lengths; }
 
-    double perimeter() const override {
-        double p_sum = 0;
+    /// Squared side lengths, for comparisons that need no sqrt
+    const std::vector<double>& squared_edge_lengths() const { return metrics()._squared_edge_lengths; }
 
-        for (size_t i = 1; i <= _points.size(); ++i) {
-            p_sum += (_points[i % _points.size()] - _points[i - 1]).length();
+    box bounding_box() const override {
+        box res(_points[0], _points[0]);
+        for (size_t i = 1; i < _points.size(); ++i) {
+            res = res.merged(box(_points[i], _points[i]));
         }
 
-        return p_sum;
+        return res;
     }
 
-    double area() const override {
-        double s_sum = 0;
+    /// Crossing number test: a ray to +x crosses the boundary an odd number of times from inside. The ray
+    /// passes an edge going up on its left and an edge going down on its right; orientation decides exactly.
+    bool contains(const vector& point) const override {
+        bool inside = false;
+        size_t k = _points.size();
+
+        for (size_t i = 0, j = k - 1; i < k; j = i++) {
+            vector a = _points[j];
+            vector b = _points[i];
+            if (on_segment(point, a, b)) { return true; }
 
-        for (size_t i = 1; i <= _points.size(); ++i) {
-            s_sum += cross_product(_points[i % _points.size()], _points[i - 1]);
+            if ((a.y > point.y) != (b.y > point.y)) {
+                if ((orientation(a, b, point) > 0) == (b.y > a.y)) { inside = !inside; }
+            }
         }
 
-        return std::abs(s_sum) / 2.0;
+        return inside;
     }
 
-    bool congruent_to(const circle& another) const { return false; }
-
-    bool congruent_to(const shape& another) const override {
-        const polygon& copy = dynamic_cast<const polygon&>(another);
-        if (_points.size() != copy._points.size()) { return false; }
+    double distance(const vector& point) const override {
+        if (contains(point)) { return 0; }
 
-        size_t k = _points.size();
-        std::vector<std::pair<size_t, size_t>> common_sides;
-        for (size_t i = 0; i < k; ++i) {
-            for (size_t j = 0; j < k; ++j) {
-                if (equal((_points[(i + 1) % k] - _points[i]).length(), (copy._points[(j + 1) % k] - copy._points[j]).length())) {
-                    common_sides.push_back(std::pair<size_t, size_t> {i, j});
-                }
-            }
+        double res = segment_distance(point, _points[_points.size() - 1], _points[0]);
+        for (size_t i = 1; i < _points.size(); ++i) {
+            res = std::min(res, segment_distance(point, _points[i - 1], _points[i]));
         }
 
-        bool flag = false;
-        for (size_t x = 0; x < common_sides.size(); ++x) {
-            size_t i = (common_sides[x].first + 1) % k;
-            size_t j = (common_sides[x].second) % k;
-            while ((i % k) != common_sides[x].first) {
-                flag = true;
-
-                if (!equal((_points[(i + 1) % k] - _points[i % k]).length(), (copy._points[mod((j - 1), k)] - copy._points[mod(j, k)]).length())) {
-                    flag = false;
-                    break;
-                }
-                ++i, --j;
-            }
+        return res;
+    }
 
-            if (flag) { return true; }
-        }
+    bool congruent_to(const circle& another) const { return false; }
 
-        flag = false;
-        for (size_t x = 0; x < common_sides.size(); ++x) {
-            size_t i = (common_sides[x].first + 1) % k;
-            size_t j = (common_sides[x].second + 1) % k;
-            while ((i % k) != common_sides[x].first) {
-                flag = true;
-                if (!equal((_points[(i + 1) % k] - _points[i % k]).length(), (copy._points[(j + 1) % k] - copy._points[j % k]).length())) {
-                    flag = false;
-                    break;
-                }
-                ++i, ++j;
-            }
+    /// Congruent (mirror images included) when the vertex signature of `another`, or of its mirror image,
+    /// is a cyclic shift of ours. The shift is found with KMP in O(k).
+    bool congruent_to(const shape& another) const override { return congruent_to(dynamic_cast<const polygon&>(another)); }
 
-            if (flag) { return true; }
-        }
+    bool congruent_to(const polygon& copy) const {
+        if (_points.size() != copy._points.size()) { return false; }
 
+        std::vector<vertex_signature> pattern = signature(_points, edge_lengths());
+        if (is_cyclic_shift(pattern, signature(copy._points, copy.edge_lengths()))) { return true; }
 
+        point_array mirrored = copy._points;
+        mirrored.transform(affine {-1, 0, 0, 1, 0, 0});
+        mirrored.reverse();
+        std::vector<double> mirrored_lengths(mirrored.blocks_size());
+        measure(mirrored, nullptr, mirrored_lengths.data());
+        mirrored_lengths.resize(mirrored.size());
 
-        return false;
+        return is_cyclic_shift(pattern, signature(mirrored, mirrored_lengths));
     }
 
     bool operator==(const circle& another) const { return false; }
     bool operator!=(const circle& another) const { return true; }
 
-    bool operator==(const shape& another) const override {
-        const polygon& copy = dynamic_cast<const polygon&>(another);
-        if (_points.size() != copy._points.size()) { return false; }
+    /// Same vertices in the same cyclic order. Both polygons are compared from their canonical first vertex,
+    /// so this is one linear pass. If a near tie for the smallest vertex was broken differently in the other
+    /// polygon, that fails and is_cyclic_shift() searches every start at once, still in linear time.
+    bool operator==(const shape& another) const override { return *this == dynamic_cast<const polygon&>(another); }
 
-        for (auto & point : _points) {
-            if (std::find(copy._points.begin(), copy._points.end(), point) == copy._points.end()) {
-                return false;
-            }
-        }
+    bool operator==(const polygon& copy) const {
+        size_t k = _points.size();
+        if (k != copy._points.size()) { return false; }
+        if (k == 0) { return true; }
 
-        return true;
+        size_t first = canonical_first(), other_first = copy.canonical_first();
+        if (matches_from(copy, first, other_first)) { return true; }
+
+        return is_cyclic_shift(get_vertices(), copy.get_vertices());
     }
 
     bool operator!=(const shape& another) const override { return !((*this) == another); }
+    bool operator!=(const polygon& another) const { return !((*this) == another); }
 
-    void rotate(double angle) override {
-        vector C = center();
-        for (auto & pt : _points) {
-            vector dC = pt - C;
-            pt.x = cos(angle) * dC.x - sin(angle) * dC.y + C.x;
-            pt.y = sin(angle) * dC.x + cos(angle) * dC.y + C.y;
-        }
-    }
+    void rotate(double angle) override { transform(affine::rotation(angle, center())); }
 
-    void scale(double coefficient) override {
-        vector C = center();
-        translate(-C);
-        for (auto & point : _points) {
-            point.x *= coefficient;
-            point.y *= coefficient;
-        }
-        translate(C);
+    void scale(double coefficient) override { transform(affine::scaling(coefficient, center())); }
+
+    void translate(vector transform) override { this->transform(affine::translation(transform)); }
+
+    /// Any composition of rotations, scalings and translations, applied in one pass over the vertices.
+    /// A reflection would turn the vertex order clockwise, so those are not allowed.
+    void transform(const affine& m) {
+        _points.transform(m);
+        invalidate();
     }
 
-    void translate(vector transform) override {
-        for (auto & point : _points) {
-            point.x += transform.x;
-            point.y += transform.y;
+    /// Index of the lexicographically smallest vertex, by x and then y. Vertices are stored counter-clockwise,
+    /// so walking from here gives the same sequence for equal polygons.
+    size_t canonical_first() const { return metrics()._canonical_first; }
+
+    /// Consistent with operator== up to HASH_STEP: does not depend on the vertex order
+    size_t hash() const {
+        size_t res = _points.size();
+        for (size_t i = 0; i < _points.size(); ++i) {
+            res += hash_value(_points[i]);
         }
+        return res;
     }
 
     size_t vertices_count() const { return _points.size(); }
-    const std::vector<vector>& get_vertices() const { return _points; }
+    std::vector<vector> get_vertices() const { return _points.to_vector(); }
+    const point_array& coordinates() const { return _points; }
 
 protected:
-    std::vector<vector> _points;
+    /// Must be called after every change of _points
+    void invalidate() { _metrics_valid = false; }
+
+    point_array _points;
+
+private:
+    bool matches_from(const polygon& other, size_t first, size_t other_first) const {
+        size_t k = _points.size();
+        for (size_t i = first, j = other_first, n = 0; n < k; ++n) {
+            if (_points[i] != other._points[j]) { return false; }
+            if (++i == k) { i = 0; }
+            if (++j == k) { j = 0; }
+        }
+        return true;
+    }
+
+    /// Area, perimeter, centroid, side lengths and the canonical first vertex, all computed on first use.
+    /// The lazy fill makes concurrent calls on the same polygon unsafe until it is done.
+    const polygon& metrics() const {
+        if (_metrics_valid) { return *this; }
+
+        _edge_lengths.resize(_points.blocks_size());
+        _squared_edge_lengths.resize(_points.blocks_size());
+        polyline_sums sums = measure(_points, _squared_edge_lengths.data(), _edge_lengths.data());
+        _edge_lengths.resize(_points.size());
+        _squared_edge_lengths.resize(_points.size());
+
+        _area = std::abs(sums.cross) / 2.0;
+        _perimeter = sums.length;
+        _centroid = sums.moment / (6 * _area);
+
+        _canonical_first = 0;
+        const double* xs = _points.x();
+        const double* ys = _points.y();
+        for (size_t i = 1; i < _points.size(); ++i) {
+            if (xs[i] < xs[_canonical_first] || (xs[i] == xs[_canonical_first] && ys[i] < ys[_canonical_first])) {
+                _canonical_first = i;
+            }
+        }
+        _metrics_valid = true;
+        return *this;
+    }
+
+    mutable bool _metrics_valid = false;
+    mutable double _area = 0;
+    mutable double _perimeter = 0;
+    mutable vector _centroid;
+    mutable size_t _canonical_first = 0;
+    mutable std::vector<double> _edge_lengths;
+    mutable std::vector<double> _squared_edge_lengths;
 };
 
 
 class rectangle: public polygon {
 public:
-    rectangle(const vector& center, const double height, const double width): _center(center), _height(height), _width(width) {
-        _points.push_back(vector(center.x + width / 2.0, center.y - height / 2.0));
-        _points.push_back(vector(center.x + width / 2.0, center.y + height / 2.0));
-        _points.push_back(vector(center.x - width / 2.0, center.y + height / 2.0));
-        _points.push_back(vector(center.x - width / 2.0, center.y - height / 2.0));
-    }
+    rectangle(const vector& center, const double height, const double width):
+        polygon(std::vector<vector> {vector(center.x + width / 2.0, center.y - height / 2.0),
+                                     vector(center.x + width / 2.0, center.y + height / 2.0),
+                                     vector(center.x - width / 2.0, center.y + height / 2.0),
+                                     vector(center.x - width / 2.0, center.y - height / 2.0)}),
+        _center(center), _height(height), _width(width) {}
 
     vector center() const override { return _center; }
 
@@ -279,6 +474,16 @@ class triangle: public polygon {
 public:
     triangle(const vector& a, const vector& b, const vector& c): polygon(std::vector<vector> {a, b, c}) {}
 
+    /// Three exact orientation tests; vertices are counter-clockwise
+    bool contains(const vector& point) const override {
+        if (orientation(_points[0], _points[1], _points[2]) == 0) { return polygon::contains(point); }
+        return orientation(_points[0], _points[1], point) >= 0 && orientation(_points[1], _points[2], point) >= 0
+               && orientation(_points[2], _points[0], point) >= 0;
+    }
+
+    /// Strictly inside the circumscribed circle, decided exactly
+    bool in_circumcircle(const vector& point) const { return incircle(_points[0], _points[1], _points[2], point) > 0; }
+
     circle circumscribed_circle() const {
         vector A = _points[0];
         vector B = _points[1];
@@ -318,4 +523,12 @@ public:
 };
 
 
+namespace std {
+    template<>
+    struct hash<polygon> {
+        size_t operator()(const polygon& value) const { return value.hash(); }
+    };
+}
+
+
 #endif //CPP_GEOMETRY_H
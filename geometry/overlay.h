@@ -0,0 +1,414 @@
+#ifndef CPP_OVERLAY_H
+#define CPP_OVERLAY_H
+
+#include "geometry.h"
+#include "point_location.h"
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+/// Orders points by x, then by y. The sweep below moves through the plane in this order.
+struct point_order {
+    bool operator()(const vector& a, const vector& b) const { return a.x < b.x || (a.x == b.x && a.y < b.y); }
+};
+
+/// Smallest convex polygon containing all points, counter-clockwise and without collinear vertices.
+/// Andrew's monotone chain, O(n log n).
+std::vector<vector> convex_hull(std::vector<vector> points) {
+    std::sort(points.begin(), points.end(), point_order());
+    points.erase(std::unique(points.begin(), points.end(), [](const vector& a, const vector& b) {
+        return a.x == b.x && a.y == b.y;
+    }), points.end());
+    if (points.size() < 3) { return points; }
+
+    std::vector<vector> hull(2 * points.size());
+    size_t k = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        while (k >= 2 && orientation(hull[k - 2], hull[k - 1], points[i]) <= 0) { --k; }
+        hull[k++] = points[i];
+    }
+    for (size_t i = points.size() - 1, lower = k + 1; i-- > 0;) {
+        while (k >= lower && orientation(hull[k - 2], hull[k - 1], points[i]) <= 0) { --k; }
+        hull[k++] = points[i];
+    }
+
+    hull.resize(k - 1);
+    return hull;
+}
+
+/// Sutherland-Hodgman: the part of `subject` inside the convex counter-clockwise `window`. Where the
+/// subject is not convex and the clipped part falls apart, the pieces stay joined along the window edges.
+std::vector<vector> clip(const std::vector<vector>& subject, const std::vector<vector>& window) {
+    std::vector<vector> res = subject;
+
+    for (size_t i = 0; i < window.size() && !res.empty(); ++i) {
+        const vector& a = window[i];
+        const vector& b = window[i + 1 == window.size() ? 0 : i + 1];
+        std::vector<vector> input;
+        input.swap(res);
+
+        for (size_t j = 0; j < input.size(); ++j) {
+            const vector& from = input[j ? j - 1 : input.size() - 1];
+            const vector& to = input[j];
+            double from_side = orient2d(a, b, from);
+            double to_side = orient2d(a, b, to);
+
+            if ((from_side >= 0) != (to_side >= 0)) {
+                res.push_back(from + (to - from) * (from_side / (from_side - to_side)));
+            }
+            if (to_side >= 0) { res.push_back(to); }
+        }
+    }
+
+    return res;
+}
+
+polygon clip(const polygon& subject, const polygon& window) {
+    return polygon(clip(subject.get_vertices(), window.get_vertices()));
+}
+
+
+struct segment {
+    segment() = default;
+    segment(const vector& from, const vector& to): from(from), to(to) {}
+
+    vector from;
+    vector to;
+};
+
+/// Returns false if the segments do not meet. Otherwise `point` is where they cross, the shared endpoint
+/// if they touch, or the start of the common part (by point_order) if they overlap.
+bool intersection(const segment& s, const segment& t, vector& point) {
+    int s_from = orientation(t.from, t.to, s.from), s_to = orientation(t.from, t.to, s.to);
+    int t_from = orientation(s.from, s.to, t.from), t_to = orientation(s.from, s.to, t.to);
+
+    if (t_from == 0 && t_to == 0) {
+        point_order less;
+        vector s_lo = std::min(s.from, s.to, less), s_hi = std::max(s.from, s.to, less);
+        vector t_lo = std::min(t.from, t.to, less), t_hi = std::max(t.from, t.to, less);
+        vector lo = std::max(s_lo, t_lo, less), hi = std::min(s_hi, t_hi, less);
+        if (less(hi, lo)) { return false; }
+
+        point = lo;
+        return true;
+    }
+    if (s_from * s_to > 0 || t_from * t_to > 0) { return false; }
+
+    if (t_from == 0) { point = t.from; }
+    else if (t_to == 0) { point = t.to; }
+    else if (s_from == 0) { point = s.from; }
+    else if (s_to == 0) { point = s.to; }
+    else {
+        vector r = s.to - s.from, d = t.to - t.from;
+        point = s.from + r * (cross_product(t.from - s.from, d) / cross_product(r, d));
+    }
+
+    return true;
+}
+
+/// Two segments meeting at `point`, first < second
+struct segment_crossing {
+    size_t first;
+    size_t second;
+    vector point;
+};
+
+/// Bentley-Ottmann sweep, O((n + k) log n) for n segments and k reported crossings. Every pair of segments
+/// passing within EPS of an event point is reported there: crossings, shared endpoints and an endpoint
+/// lying on another segment. Overlapping segments are reported at each endpoint inside the common part.
+/// Zero-length segments are ignored.
+class segment_sweep {
+public:
+    explicit segment_sweep(const std::vector<segment>& segments):
+        _segments(segments), _through(segments.size(), 0), _where(segments.size()), _status(status_order {this}) {
+        for (auto& s : _segments) {
+            if (point_order()(s.to, s.from)) { std::swap(s.from, s.to); }
+        }
+    }
+
+    std::vector<segment_crossing> run() {
+        std::vector<segment_crossing> res;
+        std::map<vector, std::vector<size_t>, point_order> events;
+        for (size_t i = 0; i < _segments.size(); ++i) {
+            if (_segments[i].from.x == _segments[i].to.x && _segments[i].from.y == _segments[i].to.y) { continue; }
+            events[_segments[i].from].push_back(i);
+            events[_segments[i].to];
+        }
+
+        while (!events.empty()) {
+            vector point = events.begin()->first;
+            std::vector<size_t> starting = std::move(events.begin()->second);
+            events.erase(events.begin());
+            while (!events.empty() && events.begin()->first == point) {
+                starting.insert(starting.end(), events.begin()->second.begin(), events.begin()->second.end());
+                events.erase(events.begin());
+            }
+
+            handle(point, starting, events, res);
+        }
+
+        return res;
+    }
+
+private:
+    static constexpr size_t PROBE_LOW = SIZE_MAX;
+    static constexpr size_t PROBE_HIGH = SIZE_MAX - 1;
+
+    /// Bottom to top along the sweep line just right of the current event point. Segments through that
+    /// point are ordered by slope; the probes stand for the point itself, below or above those segments.
+    struct status_order {
+        bool operator()(size_t a, size_t b) const {
+            double ya = sweep->height(a), yb = sweep->height(b);
+            if (ya != yb) { return ya < yb; }
+            if (a == PROBE_LOW || b == PROBE_HIGH) { return a != b; }
+            if (a == PROBE_HIGH || b == PROBE_LOW) { return false; }
+
+            double sa = sweep->slope(a), sb = sweep->slope(b);
+            if (sa != sb) { return sa < sb; }
+            return a < b;
+        }
+
+        const segment_sweep* sweep;
+    };
+
+    typedef std::set<size_t, status_order> status_type;
+
+    double height(size_t i) const {
+        if (i == PROBE_LOW || i == PROBE_HIGH || _through[i]) { return _point.y; }
+
+        const segment& s = _segments[i];
+        if (s.from.x == s.to.x) { return std::max(s.from.y, std::min(s.to.y, _point.y)); }
+        return s.from.y + (_point.x - s.from.x) * (s.to.y - s.from.y) / (s.to.x - s.from.x);
+    }
+
+    double slope(size_t i) const {
+        const segment& s = _segments[i];
+        if (s.from.x == s.to.x) { return INFINITY; }
+        return (s.to.y - s.from.y) / (s.to.x - s.from.x);
+    }
+
+    bool passes(size_t i, const vector& point) const {
+        return segment_distance(point, _segments[i].from, _segments[i].to) < EPS;
+    }
+
+    void handle(const vector& point, const std::vector<size_t>& starting,
+                std::map<vector, std::vector<size_t>, point_order>& events, std::vector<segment_crossing>& res) {
+        _point = point;
+
+        std::vector<size_t> through;
+        auto probe = _status.lower_bound(PROBE_LOW);
+        for (auto it = probe; it != _status.begin() && passes(*std::prev(it), point); --it) {
+            through.push_back(*std::prev(it));
+        }
+        for (auto it = probe; it != _status.end() && passes(*it, point); ++it) {
+            through.push_back(*it);
+        }
+
+        std::vector<size_t> all = starting;
+        all.insert(all.end(), through.begin(), through.end());
+        for (size_t i = 0; i < all.size(); ++i) {
+            for (size_t j = i + 1; j < all.size(); ++j) {
+                res.push_back(segment_crossing {std::min(all[i], all[j]), std::max(all[i], all[j]), point});
+            }
+        }
+
+        std::vector<size_t> continuing = starting;
+        for (auto i : through) {
+            _status.erase(_where[i]);
+            if (!(_segments[i].to == point)) { continuing.push_back(i); }
+        }
+
+        for (auto i : continuing) { _through[i] = 1; }
+        for (auto i : continuing) { _where[i] = _status.insert(i).first; }
+
+        auto lowest = _status.lower_bound(PROBE_LOW);
+        auto above = _status.upper_bound(PROBE_HIGH);
+        for (auto i : continuing) { _through[i] = 0; }
+
+        if (lowest != _status.begin() && lowest != _status.end()) { check(*std::prev(lowest), *lowest, events); }
+        if (!continuing.empty() && above != _status.end()) { check(*std::prev(above), *above, events); }
+    }
+
+    /// Schedules the meeting point of two neighbours if the sweep has not passed it yet
+    void check(size_t a, size_t b, std::map<vector, std::vector<size_t>, point_order>& events) const {
+        vector point;
+        if (intersection(_segments[a], _segments[b], point) && point_order()(_point, point) && !(point == _point)) {
+            events[point];
+        }
+    }
+
+    std::vector<segment> _segments;
+    /// Segments being inserted at the current event point: their height is taken to be exactly the point's
+    std::vector<char> _through;
+    std::vector<status_type::iterator> _where;
+    vector _point;
+    status_type _status;
+};
+
+std::vector<segment_crossing> segment_intersections(const std::vector<segment>& segments) {
+    return segment_sweep(segments).run();
+}
+
+
+/// Points that are equal up to EPS share one id, so pieces of edges from both polygons join exactly
+class vertex_pool {
+public:
+    size_t id(const vector& point) {
+        auto it = _ids.lower_bound(vector(point.x - EPS, -INFINITY));
+        for (; it != _ids.end() && it->first.x < point.x + EPS; ++it) {
+            if (it->first == point) { return it->second; }
+        }
+
+        _points.push_back(point);
+        _ids.emplace(point, _points.size() - 1);
+        return _points.size() - 1;
+    }
+
+    const vector& operator[](size_t id) const { return _points[id]; }
+
+private:
+    std::map<vector, size_t, point_order> _ids;
+    std::vector<vector> _points;
+};
+
+enum class boolean_operation { intersection, unite, difference };
+
+/// Boundary rings of `a` op `b`, each with the region on its left: outer boundaries are counter-clockwise,
+/// holes clockwise. Both polygons must be simple.
+///
+/// Edges of both polygons are split where they meet (found by segment_intersections), each piece is kept or
+/// dropped by whether it lies inside the other polygon, and the kept pieces are linked into rings.
+std::vector<std::vector<vector>> overlay(const polygon& a, const polygon& b, boolean_operation operation) {
+    std::vector<vector> points[2] = {a.get_vertices(), b.get_vertices()};
+    prepared_polygon shapes[2] = {prepared_polygon(a), prepared_polygon(b)};
+
+    std::vector<segment> edges;
+    for (auto& ring : points) {
+        for (size_t i = 0; i < ring.size(); ++i) {
+            edges.push_back(segment(ring[i], ring[i + 1 == ring.size() ? 0 : i + 1]));
+        }
+    }
+
+    vertex_pool pool;
+    std::vector<std::vector<size_t>> cuts(edges.size());
+    for (size_t i = 0; i < edges.size(); ++i) {
+        cuts[i].push_back(pool.id(edges[i].from));
+        cuts[i].push_back(pool.id(edges[i].to));
+    }
+    for (auto& crossing : segment_intersections(edges)) {
+        size_t id = pool.id(crossing.point);
+        cuts[crossing.first].push_back(id);
+        cuts[crossing.second].push_back(id);
+    }
+
+    // Directed pieces of the edges of each polygon, as pairs of vertex ids
+    std::vector<std::pair<size_t, size_t>> pieces[2];
+    std::set<std::pair<size_t, size_t>> lookup[2];
+    for (size_t i = 0; i < edges.size(); ++i) {
+        vector from = edges[i].from, direction = edges[i].to - edges[i].from;
+        std::vector<size_t>& ids = cuts[i];
+        std::sort(ids.begin() + 1, ids.end(), [&](size_t u, size_t v) {
+            return dot_product(pool[u] - from, direction) < dot_product(pool[v] - from, direction);
+        });
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+        size_t owner = i < points[0].size() ? 0 : 1;
+        for (size_t j = 0; j + 1 < ids.size(); ++j) {
+            pieces[owner].push_back({ids[j], ids[j + 1]});
+            lookup[owner].insert({ids[j], ids[j + 1]});
+        }
+    }
+
+    std::vector<std::pair<size_t, size_t>> kept;
+    for (size_t owner = 0; owner < 2; ++owner) {
+        size_t other = 1 - owner;
+        for (auto& piece : pieces[owner]) {
+            bool same = lookup[other].count(piece) > 0;
+            bool opposite = lookup[other].count({piece.second, piece.first}) > 0;
+            bool inside = !same && !opposite && shapes[other].contains((pool[piece.first] + pool[piece.second]) / 2.0);
+
+            bool keep = false, reverse = false;
+            switch (operation) {
+                case boolean_operation::intersection:
+                    keep = inside || (same && owner == 0);
+                    break;
+                case boolean_operation::unite:
+                    keep = (!inside && !same && !opposite) || (same && owner == 0);
+                    break;
+                case boolean_operation::difference:
+                    keep = owner == 0 ? (!inside && !same) : inside;
+                    reverse = owner == 1;
+                    break;
+            }
+
+            if (keep) { kept.push_back(reverse ? std::make_pair(piece.second, piece.first) : piece); }
+        }
+    }
+
+    std::multimap<size_t, size_t> outgoing;
+    for (size_t i = 0; i < kept.size(); ++i) {
+        outgoing.emplace(kept[i].first, i);
+    }
+
+    std::vector<std::vector<vector>> res;
+    std::vector<char> used(kept.size(), 0);
+    for (size_t start = 0; start < kept.size(); ++start) {
+        if (used[start]) { continue; }
+
+        std::vector<vector> ring;
+        size_t current = start;
+        bool closed = false;
+        while (true) {
+            used[current] = 1;
+            ring.push_back(pool[kept[current].first]);
+            if (kept[current].second == kept[start].first) { closed = true; break; }
+
+            // Of the pieces leaving the next vertex, the one turning furthest left keeps touching rings apart
+            vector incoming = pool[kept[current].second] - pool[kept[current].first];
+            size_t next = SIZE_MAX;
+            double best = -INFINITY;
+            auto range = outgoing.equal_range(kept[current].second);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (used[it->second]) { continue; }
+                vector out = pool[kept[it->second].second] - pool[kept[it->second].first];
+                double turn = std::atan2(cross_product(incoming, out), dot_product(incoming, out));
+                if (turn > best) { best = turn; next = it->second; }
+            }
+
+            if (next == SIZE_MAX) { break; }
+            current = next;
+        }
+        if (!closed) { continue; }
+
+        std::vector<vector> simplified;
+        for (size_t i = 0; i < ring.size(); ++i) {
+            const vector& prev = ring[i ? i - 1 : ring.size() - 1];
+            const vector& next = ring[i + 1 == ring.size() ? 0 : i + 1];
+            vector in = ring[i] - prev, out = next - ring[i];
+            if (std::abs(cross_product(in, out)) > EPS * in.length() * out.length() || dot_product(in, out) < 0) {
+                simplified.push_back(ring[i]);
+            }
+        }
+        if (simplified.size() >= 3) { res.push_back(simplified); }
+    }
+
+    return res;
+}
+
+std::vector<std::vector<vector>> intersection(const polygon& a, const polygon& b) {
+    return overlay(a, b, boolean_operation::intersection);
+}
+
+std::vector<std::vector<vector>> unite(const polygon& a, const polygon& b) {
+    return overlay(a, b, boolean_operation::unite);
+}
+
+std::vector<std::vector<vector>> difference(const polygon& a, const polygon& b) {
+    return overlay(a, b, boolean_operation::difference);
+}
+
+
+#endif //CPP_OVERLAY_H
@@ -0,0 +1,222 @@
+#ifndef CPP_POINT_ARRAY_H
+#define CPP_POINT_ARRAY_H
+
+#include "vector.h"
+#include <algorithm>
+#include <cmath>
+#include <new>          // for the aligned operator new
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>  // for the 4-lane kernels below
+#endif
+
+/// Allocator for vectors of doubles that SIMD kernels load with aligned instructions
+template<typename T, size_t alignment = 32>
+struct aligned_allocator {
+    typedef T value_type;
+
+    template<typename U>
+    struct rebind { typedef aligned_allocator<U, alignment> other; };
+
+    aligned_allocator() = default;
+    template<typename U>
+    aligned_allocator(const aligned_allocator<U, alignment>&) {}
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(alignment)));
+    }
+
+    void deallocate(T* pointer, size_t) {
+        ::operator delete(pointer, std::align_val_t(alignment));
+    }
+};
+
+template<typename T, typename U, size_t alignment>
+bool operator== (const aligned_allocator<T, alignment>&, const aligned_allocator<U, alignment>&) { return true; }
+template<typename T, typename U, size_t alignment>
+bool operator!= (const aligned_allocator<T, alignment>&, const aligned_allocator<U, alignment>&) { return false; }
+
+
+/// x' = xx * x + xy * y + dx, y' = yx * x + yy * y + dy
+struct affine {
+    static affine identity() { return affine {1, 0, 0, 1, 0, 0}; }
+
+    static affine translation(const vector& shift) { return affine {1, 0, 0, 1, shift.x, shift.y}; }
+
+    /// Counter-clockwise rotation by `angle` radians around `pivot`
+    static affine rotation(double angle, const vector& pivot) {
+        double c = std::cos(angle), s = std::sin(angle);
+        return affine {c, -s, s, c, pivot.x - c * pivot.x + s * pivot.y, pivot.y - s * pivot.x - c * pivot.y};
+    }
+
+    static affine scaling(double coefficient, const vector& pivot) {
+        return affine {coefficient, 0, 0, coefficient, pivot.x * (1 - coefficient), pivot.y * (1 - coefficient)};
+    }
+
+    vector operator()(const vector& point) const {
+        return vector(xx * point.x + xy * point.y + dx, yx * point.x + yy * point.y + dy);
+    }
+
+    /// `then` applied after *this
+    affine then(const affine& next) const {
+        return affine {next.xx * xx + next.xy * yx, next.xx * xy + next.xy * yy,
+                       next.yx * xx + next.yy * yx, next.yx * xy + next.yy * yy,
+                       next.xx * dx + next.xy * dy + next.dx, next.yx * dx + next.yy * dy + next.dy};
+    }
+
+    double xx, xy, yx, yy;
+    double dx, dy;
+};
+
+
+/// Points in structure-of-arrays layout: x and y in separate 32-byte aligned arrays. Both are padded
+/// past size() with copies of the first point, at least one and up to a whole block of LANES, so that
+/// the successor of point i is always at i + 1 and padded lanes add nothing to the sums below.
+class point_array {
+public:
+    static constexpr size_t LANES = 4;
+
+    point_array() = default;
+
+    explicit point_array(const std::vector<vector>& points): _size(points.size()) {
+        _x.resize(padded_size(_size));
+        _y.resize(padded_size(_size));
+        for (size_t i = 0; i < _size; ++i) {
+            _x[i] = points[i].x;
+            _y[i] = points[i].y;
+        }
+        pad();
+    }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    vector operator[](size_t i) const { return vector(_x[i], _y[i]); }
+
+    const double* x() const { return _x.data(); }
+    const double* y() const { return _y.data(); }
+
+    /// Number of points the kernels process, a multiple of LANES
+    size_t blocks_size() const { return (_size + LANES - 1) / LANES * LANES; }
+
+    std::vector<vector> to_vector() const {
+        std::vector<vector> res(_size);
+        for (size_t i = 0; i < _size; ++i) {
+            res[i] = (*this)[i];
+        }
+        return res;
+    }
+
+    void reverse() {
+        std::reverse(_x.begin(), _x.begin() + _size);
+        std::reverse(_y.begin(), _y.begin() + _size);
+        pad();
+    }
+
+    /// Applies `m` to every point in one pass
+    void transform(const affine& m) {
+        size_t n = _x.size(), i = 0;
+        double* xs = _x.data();
+        double* ys = _y.data();
+
+#if defined(__AVX2__)
+        __m256d xx = _mm256_set1_pd(m.xx), xy = _mm256_set1_pd(m.xy), dx = _mm256_set1_pd(m.dx);
+        __m256d yx = _mm256_set1_pd(m.yx), yy = _mm256_set1_pd(m.yy), dy = _mm256_set1_pd(m.dy);
+        for (; i + LANES <= n; i += LANES) {
+            __m256d x = _mm256_load_pd(xs + i);
+            __m256d y = _mm256_load_pd(ys + i);
+            _mm256_store_pd(xs + i, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(xx, x), _mm256_mul_pd(xy, y)), dx));
+            _mm256_store_pd(ys + i, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(yx, x), _mm256_mul_pd(yy, y)), dy));
+        }
+#endif
+        for (; i < n; ++i) {
+            double x = xs[i], y = ys[i];
+            xs[i] = m.xx * x + m.xy * y + m.dx;
+            ys[i] = m.yx * x + m.yy * y + m.dy;
+        }
+    }
+
+private:
+    static size_t padded_size(size_t size) { return (size + LANES - 1) / LANES * LANES + LANES; }
+
+    void pad() {
+        if (_size == 0) { return; }
+        std::fill(_x.begin() + _size, _x.end(), _x[0]);
+        std::fill(_y.begin() + _size, _y.end(), _y[0]);
+    }
+
+    std::vector<double, aligned_allocator<double>> _x;
+    std::vector<double, aligned_allocator<double>> _y;
+    size_t _size = 0;
+};
+
+
+/// Sums over the closed polyline through the points, in one pass
+struct polyline_sums {
+    /// Twice the signed area: the sum of cross(p[i], p[i + 1])
+    double cross;
+    double length;
+    /// Sum of (p[i] + p[i + 1]) * cross(p[i], p[i + 1]): six times the signed area times the centroid
+    vector moment;
+};
+
+/// Also writes the squared and plain side lengths, if given, for the side from point i to point i + 1.
+/// Both buffers need room for blocks_size() values.
+polyline_sums measure(const point_array& points, double* squared_lengths = nullptr, double* lengths = nullptr) {
+    const double* xs = points.x();
+    const double* ys = points.y();
+    size_t n = points.blocks_size(), i = 0;
+    polyline_sums res {0, 0, vector(0, 0)};
+
+#if defined(__AVX2__)
+    __m256d cross_sum = _mm256_setzero_pd(), length_sum = _mm256_setzero_pd();
+    __m256d moment_x = _mm256_setzero_pd(), moment_y = _mm256_setzero_pd();
+    for (; i < n; i += point_array::LANES) {
+        __m256d ax = _mm256_load_pd(xs + i), ay = _mm256_load_pd(ys + i);
+        __m256d bx = _mm256_loadu_pd(xs + i + 1), by = _mm256_loadu_pd(ys + i + 1);
+
+        __m256d cross = _mm256_sub_pd(_mm256_mul_pd(ax, by), _mm256_mul_pd(ay, bx));
+        cross_sum = _mm256_add_pd(cross_sum, cross);
+        moment_x = _mm256_add_pd(moment_x, _mm256_mul_pd(_mm256_add_pd(ax, bx), cross));
+        moment_y = _mm256_add_pd(moment_y, _mm256_mul_pd(_mm256_add_pd(ay, by), cross));
+
+        __m256d sx = _mm256_sub_pd(bx, ax), sy = _mm256_sub_pd(by, ay);
+        __m256d squared = _mm256_add_pd(_mm256_mul_pd(sx, sx), _mm256_mul_pd(sy, sy));
+        __m256d length = _mm256_sqrt_pd(squared);
+        length_sum = _mm256_add_pd(length_sum, length);
+        if (squared_lengths != nullptr) { _mm256_storeu_pd(squared_lengths + i, squared); }
+        if (lengths != nullptr) { _mm256_storeu_pd(lengths + i, length); }
+    }
+
+    alignas(32) double lanes[4][point_array::LANES];
+    _mm256_store_pd(lanes[0], cross_sum);
+    _mm256_store_pd(lanes[1], length_sum);
+    _mm256_store_pd(lanes[2], moment_x);
+    _mm256_store_pd(lanes[3], moment_y);
+    for (size_t lane = 0; lane < point_array::LANES; ++lane) {
+        res.cross += lanes[0][lane];
+        res.length += lanes[1][lane];
+        res.moment.x += lanes[2][lane];
+        res.moment.y += lanes[3][lane];
+    }
+#endif
+    for (; i < n; ++i) {
+        double cross = xs[i] * ys[i + 1] - ys[i] * xs[i + 1];
+        res.cross += cross;
+        res.moment.x += (xs[i] + xs[i + 1]) * cross;
+        res.moment.y += (ys[i] + ys[i + 1]) * cross;
+
+        double sx = xs[i + 1] - xs[i], sy = ys[i + 1] - ys[i];
+        double squared = sx * sx + sy * sy;
+        double length = std::sqrt(squared);
+        res.length += length;
+        if (squared_lengths != nullptr) { squared_lengths[i] = squared; }
+        if (lengths != nullptr) { lengths[i] = length; }
+    }
+
+    return res;
+}
+
+
+#endif //CPP_POINT_ARRAY_H
@@ -0,0 +1,281 @@
+#ifndef CPP_POINT_LOCATION_H
+#define CPP_POINT_LOCATION_H
+
+#include "geometry.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>  // for testing 4 edges or 4 points at once
+#endif
+
+/// A polygon prepared for many polygon::contains queries. Single convex queries are answered by a binary
+/// search for the wedge around the first vertex, O(log n). Otherwise the edges are kept in horizontal buckets
+/// and only the edges of the bucket the point falls in are tested. As with polygon::contains, the answers
+/// are exact and points on the boundary are contained. The polygon is copied, so later changes to it are not seen.
+class prepared_polygon {
+public:
+    explicit prepared_polygon(const polygon& shape): _points(shape.coordinates()), _convex(is_convex(_points)) {
+        if (_points.size() >= 3) { build_buckets(); }
+    }
+
+    bool convex() const { return _convex; }
+
+    bool contains(const vector& point) const {
+        if (_points.size() < 3) { return false; }
+        return _convex ? wedge_contains(point) : bucket_contains(point);
+    }
+
+    /// Bit i % 64 of word i / 64 is set if points[i] is contained. Under AVX2 the points are sorted into
+    /// the edge buckets and every edge is tested against four points of its bucket at once.
+    std::vector<uint64_t> contains(const point_array& points) const {
+        size_t n = points.size();
+        std::vector<uint64_t> res((n + 63) / 64, 0);
+        if (_points.size() < 3) { return res; }
+
+#if defined(__AVX2__)
+        const double* xs = points.x();
+        const double* ys = points.y();
+
+        // Chunks of points are counting-sorted by bucket, every bucket padded to a multiple of 4. A chunk is
+        // large against the bucket count, so the padding stays small, and its scratch stays in cache.
+        const size_t chunk = std::max<size_t>(4096, 8 * _buckets), none = std::numeric_limits<uint32_t>::max();
+        std::vector<size_t> first(_buckets + 1), cursor(_buckets);
+        std::vector<uint32_t> order;
+        std::vector<double, aligned_allocator<double>> qx, qy;
+
+        for (size_t begin = 0; begin < n; begin += chunk) {
+            size_t end = std::min(n, begin + chunk);
+            std::fill(first.begin(), first.end(), 0);
+            for (size_t i = begin; i < end; ++i) {
+                if (ys[i] >= _low && ys[i] <= _high) { ++first[bucket(ys[i]) + 1]; }
+            }
+            for (size_t j = 0; j < _buckets; ++j) {
+                cursor[j] = first[j];
+                first[j + 1] = first[j] + (first[j + 1] + 3) / 4 * 4;
+            }
+
+            order.assign(first[_buckets], none);
+            qx.assign(first[_buckets], _points[0].x);
+            qy.assign(first[_buckets], _points[0].y);
+            for (size_t i = begin; i < end; ++i) {
+                if (ys[i] < _low || ys[i] > _high) { continue; }
+                size_t at = cursor[bucket(ys[i])]++;
+                order[at] = static_cast<uint32_t>(i - begin);
+                qx[at] = xs[i];
+                qy[at] = ys[i];
+            }
+
+            for (size_t j = 0; j < _buckets; ++j) {
+                for (size_t at = first[j]; at < first[j + 1]; at += 4) {
+                    __m256d px = _mm256_load_pd(&qx[at]), py = _mm256_load_pd(&qy[at]);
+                    __m256d crossings = _mm256_setzero_pd();
+                    int unsure = 0;
+                    for (size_t e = _offsets[j]; e < _offsets[j + 1]; ++e) {
+                        lane_tests lanes = test_lanes(_mm256_set1_pd(_ax[e]), _mm256_set1_pd(_ay[e]),
+                                                      _mm256_set1_pd(_bx[e]), _mm256_set1_pd(_by[e]), px, py);
+                        crossings = _mm256_xor_pd(crossings, lanes.crossing);
+                        unsure |= lanes.unsure;
+                    }
+
+                    int inside = _mm256_movemask_pd(crossings);
+                    for (size_t lane = 0; lane < 4; ++lane) {
+                        if (order[at + lane] == none) { continue; }
+                        size_t i = begin + order[at + lane];
+                        bool contained = (unsure >> lane) & 1 ? bucket_contains(points[i]) : (inside >> lane) & 1;
+                        if (contained) { res[i / 64] |= uint64_t(1) << (i % 64); }
+                    }
+                }
+            }
+        }
+#else
+        for (size_t i = 0; i < n; ++i) {
+            if (contains(points[i])) { res[i / 64] |= uint64_t(1) << (i % 64); }
+        }
+#endif
+        return res;
+    }
+
+private:
+    static bool is_convex(const point_array& points) {
+        size_t k = points.size();
+        for (size_t i = 0; i < k; ++i) {
+            if (orientation(points[i], points[i + 1], points[(i + 2) % k]) < 0) { return false; }
+        }
+        for (size_t i = 1; i + 1 < k; ++i) {
+            if (orientation(points[0], points[i], points[i + 1]) < 0) { return false; }
+        }
+        return true;
+    }
+
+    /// Vertices 1..k-1 seen from vertex 0 turn counter-clockwise; the point is in the wedge between
+    /// vertices i and i + 1 where the turn from it changes sign
+    bool wedge_contains(const vector& point) const {
+        size_t k = _points.size();
+        vector origin = _points[0];
+
+        int first_side = orientation(origin, _points[1], point), last_side = orientation(origin, _points[k - 1], point);
+        if (first_side < 0 || last_side > 0) {
+            return on_segment(point, origin, _points[1]) || on_segment(point, _points[k - 1], origin);
+        }
+        // On a supporting line through vertex 0, which may hold several collinear edges: only the boundary counts
+        if (first_side == 0 || last_side == 0) { return bucket_contains(point); }
+
+        size_t lo = 1, hi = k - 1;
+        while (hi - lo > 1) {
+            size_t mid = (lo + hi) / 2;
+            if (orientation(origin, _points[mid], point) >= 0) { lo = mid; } else { hi = mid; }
+        }
+
+        vector a = _points[lo], b = _points[lo + 1];
+        return orientation(a, b, point) >= 0;
+    }
+
+    /// Buckets split the y range of the polygon evenly. An edge is listed in every bucket its y range overlaps;
+    /// there are at most as many buckets as edges, and fewer if the edges are long in y, so the lists hold at
+    /// most about twice as many entries as there are edges. Each bucket stores its edges in structure-of-arrays
+    /// form, padded to a multiple of 4 with empty edges at the first vertex, which are never crossed.
+    void build_buckets() {
+        size_t k = _points.size();
+        box bounds = shape_bounds();
+        _low = bounds.lo.y;
+        _high = bounds.hi.y;
+        double spans = 0;
+        for (size_t i = 0; i < k; ++i) {
+            spans += std::abs(_points[i + 1].y - _points[i].y);
+        }
+        _step = std::max((_high - _low) / k, spans / k);
+        _buckets = _step > 0 ? std::max<size_t>(1, std::min<size_t>(k, static_cast<size_t>((_high - _low) / _step))) : 1;
+        _step = (_high - _low) / _buckets;
+
+        std::vector<std::vector<size_t>> members(_buckets);
+        for (size_t i = 0; i < k; ++i) {
+            vector a = _points[i], b = _points[i + 1];
+            if (a.x == b.x && a.y == b.y) { continue; }
+            size_t first = bucket(std::min(a.y, b.y)), last = bucket(std::max(a.y, b.y));
+            for (size_t j = first; j <= last; ++j) {
+                members[j].push_back(i);
+            }
+        }
+
+        _offsets.assign(_buckets + 1, 0);
+        for (size_t j = 0; j < _buckets; ++j) {
+            _offsets[j + 1] = _offsets[j] + (members[j].size() + 3) / 4 * 4;
+        }
+
+        size_t total = _offsets[_buckets];
+        _ax.assign(total, _points[0].x);
+        _ay.assign(total, _points[0].y);
+        _bx.assign(total, _points[0].x);
+        _by.assign(total, _points[0].y);
+
+        for (size_t j = 0; j < _buckets; ++j) {
+            for (size_t e = 0; e < members[j].size(); ++e) {
+                size_t at = _offsets[j] + e;
+                vector a = _points[members[j][e]], b = _points[members[j][e] + 1];
+                _ax[at] = a.x;
+                _ay[at] = a.y;
+                _bx[at] = b.x;
+                _by[at] = b.y;
+            }
+        }
+    }
+
+    box shape_bounds() const {
+        box res(_points[0], _points[0]);
+        for (size_t i = 1; i < _points.size(); ++i) {
+            res = res.merged(box(_points[i], _points[i]));
+        }
+        return res;
+    }
+
+    size_t bucket(double y) const {
+        if (!(_step > 0) || y <= _low) { return 0; }
+        return std::min(_buckets - 1, static_cast<size_t>((y - _low) / _step));
+    }
+
+    /// Exact test of edge i: true if the point lies on it, otherwise flips `inside` if the ray to +x crosses it
+    bool on_edge(size_t i, const vector& point, bool& inside) const {
+        vector a(_ax[i], _ay[i]), b(_bx[i], _by[i]);
+        if (on_segment(point, a, b)) { return true; }
+        if ((a.y > point.y) != (b.y > point.y) && (orientation(a, b, point) > 0) == (b.y > a.y)) { inside = !inside; }
+        return false;
+    }
+
+#if defined(__AVX2__)
+    struct lane_tests {
+        /// All ones where the ray to +x from p crosses the edge a -> b
+        __m256d crossing;
+        /// Bit i is set when lane i may cross or touch the edge and the sign of its orient2d is not certain
+        int unsure;
+    };
+
+    /// orient2d(a, b, p) per lane, evaluated in doubles exactly as orient2d does with the same error bound
+    static lane_tests test_lanes(__m256d ax, __m256d ay, __m256d bx, __m256d by, __m256d px, __m256d py) {
+        const __m256d sign = _mm256_set1_pd(-0.), error = _mm256_set1_pd(ORIENT_ERROR_BOUND);
+        __m256d left = _mm256_mul_pd(_mm256_sub_pd(ax, px), _mm256_sub_pd(by, py));
+        __m256d right = _mm256_mul_pd(_mm256_sub_pd(ay, py), _mm256_sub_pd(bx, px));
+        __m256d det = _mm256_sub_pd(left, right);
+        __m256d bound = _mm256_mul_pd(error, _mm256_add_pd(_mm256_andnot_pd(sign, left), _mm256_andnot_pd(sign, right)));
+
+        __m256d straddles = _mm256_xor_pd(_mm256_cmp_pd(ay, py, _CMP_GT_OQ), _mm256_cmp_pd(by, py, _CMP_GT_OQ));
+        __m256d in_x = _mm256_and_pd(_mm256_cmp_pd(_mm256_min_pd(ax, bx), px, _CMP_LE_OQ), _mm256_cmp_pd(px, _mm256_max_pd(ax, bx), _CMP_LE_OQ));
+        __m256d in_y = _mm256_and_pd(_mm256_cmp_pd(_mm256_min_pd(ay, by), py, _CMP_LE_OQ), _mm256_cmp_pd(py, _mm256_max_pd(ay, by), _CMP_LE_OQ));
+        __m256d relevant = _mm256_or_pd(straddles, _mm256_and_pd(in_x, in_y));
+
+        __m256d turns_left = _mm256_cmp_pd(det, _mm256_setzero_pd(), _CMP_GT_OQ), up = _mm256_cmp_pd(by, ay, _CMP_GT_OQ);
+        return lane_tests {_mm256_andnot_pd(_mm256_xor_pd(turns_left, up), straddles),
+                           _mm256_movemask_pd(_mm256_and_pd(relevant, _mm256_cmp_pd(_mm256_andnot_pd(sign, det), bound, _CMP_LE_OQ)))};
+    }
+#endif
+
+    /// Crossing number over the edges of one bucket. The vector path tests four edges at a time, and hands
+    /// a block to on_edge when the sign of a relevant edge is not certain.
+    bool bucket_contains(const vector& point) const {
+        if (point.y < _low || point.y > _high) { return false; }
+
+        size_t j = bucket(point.y), i = _offsets[j], end = _offsets[j + 1];
+        bool inside = false;
+
+#if defined(__AVX2__)
+        __m256d px = _mm256_set1_pd(point.x), py = _mm256_set1_pd(point.y);
+        int crossings = 0;
+        for (; i < end; i += 4) {
+            lane_tests lanes = test_lanes(_mm256_load_pd(&_ax[i]), _mm256_load_pd(&_ay[i]),
+                                          _mm256_load_pd(&_bx[i]), _mm256_load_pd(&_by[i]), px, py);
+            if (lanes.unsure) {
+                for (size_t e = i; e < i + 4; ++e) {
+                    if (on_edge(e, point, inside)) { return true; }
+                }
+                continue;
+            }
+            crossings ^= _mm256_movemask_pd(lanes.crossing);
+        }
+        if (__builtin_popcount(crossings) & 1) { inside = !inside; }
+#endif
+        for (; i < end; ++i) {
+            if (on_edge(i, point, inside)) { return true; }
+        }
+
+        return inside;
+    }
+
+    point_array _points;
+    bool _convex;
+
+    double _low = 0;
+    double _high = 0;
+    double _step = 0;
+    size_t _buckets = 0;
+    std::vector<size_t> _offsets;
+    std::vector<double, aligned_allocator<double>> _ax;
+    std::vector<double, aligned_allocator<double>> _ay;
+    std::vector<double, aligned_allocator<double>> _bx;
+    std::vector<double, aligned_allocator<double>> _by;
+};
+
+
+#endif //CPP_POINT_LOCATION_H
@@ -0,0 +1,341 @@
+#ifndef CPP_RTREE_H
+#define CPP_RTREE_H
+
+#include "geometry.h"
+#include <memory>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// R-tree over shapes, keyed by their bounding boxes. The tree does not own the shapes; a shape
+/// must be erased before it is moved or destroyed and inserted again afterwards.
+class rtree {
+public:
+    static constexpr size_t MAX_ENTRIES = 16;
+    static constexpr size_t MIN_ENTRIES = 6;
+
+    rtree(): _root(new node(true)), _size(0) {}
+
+    /// Bulk loads the shapes with Sort-Tile-Recursive packing: near-full nodes with little overlap
+    explicit rtree(const std::vector<const shape*>& shapes): rtree() {
+        if (shapes.empty()) { return; }
+
+        std::vector<std::unique_ptr<node>> level;
+        std::vector<item> items;
+        for (auto element : shapes) {
+            items.push_back(item {element->bounding_box(), element});
+        }
+
+        for (auto& group : tile(items, [](const item& it) { return it.bounds; })) {
+            std::unique_ptr<node> leaf(new node(true));
+            leaf->items = std::move(group);
+            leaf->update_bounds();
+            for (auto& it : leaf->items) {
+                _leaf_of[it.element] = leaf.get();
+            }
+            level.push_back(std::move(leaf));
+        }
+
+        while (level.size() > 1) {
+            std::vector<std::unique_ptr<node>> upper;
+            for (auto& group : tile(level, [](const std::unique_ptr<node>& child) { return child->bounds; })) {
+                std::unique_ptr<node> parent(new node(false));
+                for (auto& child : group) {
+                    parent->adopt(std::move(child));
+                }
+                parent->update_bounds();
+                upper.push_back(std::move(parent));
+            }
+            level = std::move(upper);
+        }
+
+        _root = std::move(level[0]);
+        _size = shapes.size();
+    }
+
+    rtree(const rtree& other) = delete;
+    rtree& operator=(const rtree& other) = delete;
+    ~rtree() = default;
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    void insert(const shape* element) {
+        insert_item(item {element->bounding_box(), element});
+        ++_size;
+    }
+
+    /// Returns false if the shape is not in the tree
+    bool erase(const shape* element) {
+        auto found = _leaf_of.find(element);
+        if (found == _leaf_of.end()) { return false; }
+
+        node* leaf = found->second;
+        _leaf_of.erase(found);
+        for (size_t i = 0; i < leaf->items.size(); ++i) {
+            if (leaf->items[i].element == element) {
+                leaf->items.erase(leaf->items.begin() + i);
+                break;
+            }
+        }
+
+        condense(leaf);
+        --_size;
+        return true;
+    }
+
+    /// Shapes that contain `point`
+    std::vector<const shape*> at(const vector& point) const {
+        std::vector<const shape*> res;
+        visit([&](const box& bounds) { return bounds.contains(point); },
+              [&](const item& it) { if (it.element->contains(point)) { res.push_back(it.element); } });
+        return res;
+    }
+
+    /// Shapes whose bounding boxes intersect `range`
+    std::vector<const shape*> in_range(const box& range) const {
+        std::vector<const shape*> res;
+        visit([&](const box& bounds) { return bounds.intersects(range); },
+              [&](const item& it) { res.push_back(it.element); });
+        return res;
+    }
+
+    /// Closest shape to `point` by shape::distance, nullptr for an empty tree. Best-first search:
+    /// nodes and shapes are expanded in order of the distance to their bounding boxes.
+    const shape* nearest(const vector& point) const {
+        typedef std::pair<double, std::pair<const node*, const shape*>> candidate;
+        std::priority_queue<candidate, std::vector<candidate>, std::greater<candidate>> queue;
+
+        if (_size == 0) { return nullptr; }
+
+        const shape* best = nullptr;
+        double best_distance = INFINITY;
+        queue.push({_root->bounds.distance(point), {_root.get(), nullptr}});
+
+        while (!queue.empty() && queue.top().first < best_distance) {
+            const node* current = queue.top().second.first;
+            const shape* candidate_shape = queue.top().second.second;
+            queue.pop();
+
+            if (candidate_shape != nullptr) {
+                double distance = candidate_shape->distance(point);
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best = candidate_shape;
+                }
+            } else if (current->leaf) {
+                for (auto& it : current->items) {
+                    queue.push({it.bounds.distance(point), {nullptr, it.element}});
+                }
+            } else {
+                for (auto& child : current->children) {
+                    queue.push({child->bounds.distance(point), {child.get(), nullptr}});
+                }
+            }
+        }
+
+        return best;
+    }
+
+private:
+    struct item {
+        box bounds;
+        const shape* element;
+    };
+
+    struct node {
+        explicit node(bool leaf): leaf(leaf), parent(nullptr) {}
+
+        size_t count() const { return leaf ? items.size() : children.size(); }
+
+        void adopt(std::unique_ptr<node> child) {
+            child->parent = this;
+            children.push_back(std::move(child));
+        }
+
+        void update_bounds() {
+            bounds = box();
+            for (auto& it : items) { bounds = bounds.merged(it.bounds); }
+            for (auto& child : children) { bounds = bounds.merged(child->bounds); }
+        }
+
+        box bounds;
+        bool leaf;
+        node* parent;
+        std::vector<item> items;
+        std::vector<std::unique_ptr<node>> children;
+    };
+
+    /// Sort-Tile-Recursive grouping: sort by x, cut into vertical slices, sort each slice by y
+    /// and cut it into groups of MAX_ENTRIES
+    template<typename entry, typename bounds_of>
+    static std::vector<std::vector<entry>> tile(std::vector<entry>& entries, bounds_of bounds) {
+        size_t groups = (entries.size() + MAX_ENTRIES - 1) / MAX_ENTRIES;
+        size_t slices = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(groups))));
+        size_t slice_size = slices * MAX_ENTRIES;
+
+        std::sort(entries.begin(), entries.end(), [&](const entry& a, const entry& b) {
+            return bounds(a).center().x < bounds(b).center().x;
+        });
+
+        std::vector<std::vector<entry>> res;
+        for (size_t begin = 0; begin < entries.size(); begin += slice_size) {
+            auto slice_begin = entries.begin() + begin;
+            auto slice_end = entries.begin() + std::min(begin + slice_size, entries.size());
+            std::sort(slice_begin, slice_end, [&](const entry& a, const entry& b) {
+                return bounds(a).center().y < bounds(b).center().y;
+            });
+
+            for (auto it = slice_begin; it < slice_end; it += std::min<size_t>(MAX_ENTRIES, slice_end - it)) {
+                res.emplace_back(std::make_move_iterator(it), std::make_move_iterator(it + std::min<size_t>(MAX_ENTRIES, slice_end - it)));
+            }
+        }
+
+        return res;
+    }
+
+    template<typename node_filter, typename item_visitor>
+    void visit(node_filter filter, item_visitor fn) const {
+        if (_size == 0) { return; }
+
+        std::vector<const node*> stack {_root.get()};
+        while (!stack.empty()) {
+            const node* current = stack.back();
+            stack.pop_back();
+
+            if (current->leaf) {
+                for (auto& it : current->items) {
+                    if (filter(it.bounds)) { fn(it); }
+                }
+            } else {
+                for (auto& child : current->children) {
+                    if (filter(child->bounds)) { stack.push_back(child.get()); }
+                }
+            }
+        }
+    }
+
+    /// Descends along the child whose box grows least, ties broken by the smaller box
+    node* choose_leaf(const box& bounds) const {
+        node* current = _root.get();
+        while (!current->leaf) {
+            node* best = nullptr;
+            double best_growth = INFINITY, best_area = INFINITY;
+            for (auto& child : current->children) {
+                double area = child->bounds.area();
+                double growth = child->bounds.merged(bounds).area() - area;
+                if (growth < best_growth || (growth == best_growth && area < best_area)) {
+                    best = child.get();
+                    best_growth = growth;
+                    best_area = area;
+                }
+            }
+            current = best;
+        }
+
+        return current;
+    }
+
+    void insert_item(const item& it) {
+        node* leaf = choose_leaf(it.bounds);
+        leaf->items.push_back(it);
+        _leaf_of[it.element] = leaf;
+
+        for (node* current = leaf; current != nullptr; current = current->parent) {
+            if (current->count() > MAX_ENTRIES) { split(current); }
+            current->update_bounds();
+        }
+    }
+
+    /// Sorts the entries of an overflowing node along the longer side of its box and moves the upper
+    /// half into a new sibling
+    void split(node* full) {
+        full->update_bounds();
+        bool by_x = (full->bounds.hi.x - full->bounds.lo.x) >= (full->bounds.hi.y - full->bounds.lo.y);
+        auto key = [by_x](const box& bounds) { return by_x ? bounds.center().x : bounds.center().y; };
+
+        std::unique_ptr<node> sibling(new node(full->leaf));
+        size_t half = full->count() / 2;
+        if (full->leaf) {
+            std::sort(full->items.begin(), full->items.end(), [&](const item& a, const item& b) { return key(a.bounds) < key(b.bounds); });
+            sibling->items.assign(full->items.begin() + half, full->items.end());
+            full->items.resize(half);
+            for (auto& it : sibling->items) {
+                _leaf_of[it.element] = sibling.get();
+            }
+        } else {
+            std::sort(full->children.begin(), full->children.end(), [&](const std::unique_ptr<node>& a, const std::unique_ptr<node>& b) {
+                return key(a->bounds) < key(b->bounds);
+            });
+            for (size_t i = half; i < full->children.size(); ++i) {
+                sibling->adopt(std::move(full->children[i]));
+            }
+            full->children.resize(half);
+        }
+        sibling->update_bounds();
+
+        if (full->parent == nullptr) {
+            std::unique_ptr<node> root(new node(false));
+            root->adopt(std::move(_root));
+            root->adopt(std::move(sibling));
+            _root = std::move(root);
+            _root->update_bounds();
+        } else {
+            full->parent->adopt(std::move(sibling));
+        }
+    }
+
+    /// Removes underfull nodes on the way up from `leaf` and reinserts the shapes they held
+    void condense(node* leaf) {
+        std::vector<item> orphans;
+
+        node* current = leaf;
+        while (current->parent != nullptr) {
+            node* parent = current->parent;
+            if (current->count() < MIN_ENTRIES) {
+                collect(current, orphans);
+                for (size_t i = 0; i < parent->children.size(); ++i) {
+                    if (parent->children[i].get() == current) {
+                        parent->children.erase(parent->children.begin() + i);
+                        break;
+                    }
+                }
+            } else {
+                current->update_bounds();
+            }
+            current = parent;
+        }
+        current->update_bounds();
+
+        while (!_root->leaf && _root->children.size() == 1) {
+            std::unique_ptr<node> child = std::move(_root->children[0]);
+            child->parent = nullptr;
+            _root = std::move(child);
+        }
+        if (!_root->leaf && _root->children.empty()) {
+            _root.reset(new node(true));
+        }
+
+        for (auto& it : orphans) {
+            insert_item(it);
+        }
+    }
+
+    static void collect(const node* subtree, std::vector<item>& items) {
+        if (subtree->leaf) {
+            items.insert(items.end(), subtree->items.begin(), subtree->items.end());
+        } else {
+            for (auto& child : subtree->children) {
+                collect(child.get(), items);
+            }
+        }
+    }
+
+    std::unique_ptr<node> _root;
+    std::unordered_map<const shape*, node*> _leaf_of;
+    size_t _size;
+};
+
+
+#endif //CPP_RTREE_H
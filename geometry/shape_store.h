@@ -0,0 +1,132 @@
+#ifndef CPP_SHAPE_STORE_H
+#define CPP_SHAPE_STORE_H
+
+#include "geometry.h"
+#include <stdexcept>    // for std::invalid_argument
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>     // for typeid
+#include <utility>
+#include <variant>
+#include <vector>
+
+/// Shapes partitioned by concrete type into one contiguous array per type. Batch operations walk the
+/// arrays one at a time and call members by qualified name, so no call goes through the vtable.
+/// A shape is stored by value and only in the array of its exact type.
+template<typename... kinds>
+class basic_shape_store {
+public:
+    /// A stored shape with its concrete type. Invalidated by insertions and erasures, like a vector iterator.
+    typedef std::variant<const kinds*...> const_pointer;
+    typedef std::variant<kinds*...> pointer;
+
+    size_t size() const { return (get<kinds>().size() + ... + 0); }
+    bool empty() const { return size() == 0; }
+
+    void clear() { (array<kinds>().clear(), ...); }
+
+    template<typename kind>
+    const std::vector<kind>& get() const { return std::get<std::vector<kind>>(_arrays); }
+
+    template<typename kind, typename = std::enable_if_t<(std::is_same_v<kind, kinds> || ...)>>
+    void insert(kind value) { array<kind>().push_back(std::move(value)); }
+
+    /// Copies a shape known only through its base into the array of its exact type
+    void insert(const shape& value) {
+        if (!(insert_if_kind<kinds>(value) || ...)) {
+            throw std::invalid_argument(std::string("Error: no array for shapes of type ") + typeid(value).name());
+        }
+    }
+
+    /// Calls `fn` with every shape as a reference to its concrete type, one type after another
+    template<typename visitor>
+    void visit(visitor fn) {
+        (visit_array(array<kinds>(), fn), ...);
+    }
+
+    template<typename visitor>
+    void visit(visitor fn) const {
+        (visit_array(get<kinds>(), fn), ...);
+    }
+
+    double total_area() const { return (area_of(get<kinds>()) + ... + 0.); }
+
+    double total_perimeter() const { return (perimeter_of(get<kinds>()) + ... + 0.); }
+
+    void translate(const vector& shift) { (translate_all(array<kinds>(), shift), ...); }
+
+    /// Shapes for which `predicate`, called with the concrete type, returns true
+    template<typename filter>
+    std::vector<const_pointer> select(filter predicate) const {
+        std::vector<const_pointer> res;
+        visit([&](const auto& value) {
+            if (predicate(value)) { res.push_back(const_pointer(&value)); }
+        });
+        return res;
+    }
+
+    /// Removes the shapes for which `predicate` returns true, keeping the order of the rest
+    template<typename filter>
+    size_t erase_if(filter predicate) {
+        size_t before = size();
+        (erase_from(array<kinds>(), predicate), ...);
+        return before - size();
+    }
+
+private:
+    template<typename kind>
+    std::vector<kind>& array() { return std::get<std::vector<kind>>(_arrays); }
+
+    template<typename kind>
+    bool insert_if_kind(const shape& value) {
+        if (typeid(value) != typeid(kind)) { return false; }
+        array<kind>().push_back(static_cast<const kind&>(value));
+        return true;
+    }
+
+    template<typename values_type, typename visitor>
+    static void visit_array(values_type& values, visitor& fn) {
+        for (auto& value : values) {
+            fn(value);
+        }
+    }
+
+    template<typename kind>
+    static double area_of(const std::vector<kind>& values) {
+        double res = 0;
+        for (auto& value : values) {
+            res += value.kind::area();
+        }
+        return res;
+    }
+
+    template<typename kind>
+    static double perimeter_of(const std::vector<kind>& values) {
+        double res = 0;
+        for (auto& value : values) {
+            res += value.kind::perimeter();
+        }
+        return res;
+    }
+
+    template<typename kind>
+    static void translate_all(std::vector<kind>& values, const vector& shift) {
+        for (auto& value : values) {
+            value.kind::translate(shift);
+        }
+    }
+
+    template<typename kind, typename filter>
+    static void erase_from(std::vector<kind>& values, filter& predicate) {
+        values.erase(std::remove_if(values.begin(), values.end(), [&](const kind& value) { return predicate(value); }),
+                     values.end());
+    }
+
+    std::tuple<std::vector<kinds>...> _arrays;
+};
+
+typedef basic_shape_store<circle, triangle, rectangle, square, polygon> shape_store;
+
+
+#endif //CPP_SHAPE_STORE_H
@@ -1,7 +1,9 @@
 #ifndef CPP_VECTOR_H
 #define CPP_VECTOR_H
 
+#include <algorithm>    // for std::copy
 #include <cmath>
+#include <cstddef>      // for size_t
 
 const double EPS = 1e-6;
 
@@ -64,4 +66,181 @@ double dot_product (const vector& lhs, const vector& rhs) { return lhs.x * rhs.x
 double cross_product (const vector& lhs, const vector& rhs) { return lhs.x * rhs.y - lhs.y * rhs.x; }
 bool collinear (const vector& lhs, const vector& rhs) { return equal(cross_product(lhs, rhs), 0.); }
 
+
+/// a + b = sum + error exactly, for any doubles (Knuth)
+void two_sum(double a, double b, double& sum, double& error) {
+    sum = a + b;
+    double b_virtual = sum - a, a_virtual = sum - b_virtual;
+    error = (a - a_virtual) + (b - b_virtual);
+}
+
+/// A number kept exactly as a sum of doubles: nonoverlapping components in increasing magnitude, zeros
+/// dropped, so the last component carries the sign. Arithmetic after Shewchuk, "Adaptive Precision
+/// Floating-Point Arithmetic and Fast Robust Geometric Predicates"; it is exact unless it overflows.
+/// The components live in a fixed array: every operation returns an expansion with room for the most
+/// components its result can have, so the predicates below never allocate.
+template<size_t capacity>
+class expansion {
+public:
+    expansion() = default;
+
+    /// Exactly high + low, for a pair as two_sum() or an fma product returns it
+    expansion(double high, double low) {
+        static_assert(capacity >= 2, "Two components need room for two");
+        if (low != 0) { _terms[_size++] = low; }
+        if (high != 0) { _terms[_size++] = high; }
+    }
+
+    /// The same value with room for more components
+    template<size_t other_capacity>
+    explicit expansion(const expansion<other_capacity>& other): _size(other._size) {
+        static_assert(other_capacity <= capacity, "An expansion can only grow");
+        std::copy(other._terms, other._terms + other._size, _terms);
+    }
+
+    expansion operator- () const {
+        expansion res = *this;
+        for (size_t i = 0; i < _size; ++i) { res._terms[i] = -_terms[i]; }
+        return res;
+    }
+
+    template<size_t other_capacity>
+    expansion<capacity + other_capacity> operator+ (const expansion<other_capacity>& other) const {
+        expansion<capacity + other_capacity> res(*this);
+        for (size_t i = 0; i < other._size; ++i) { res.add(other._terms[i]); }
+        return res;
+    }
+
+    template<size_t other_capacity>
+    expansion<capacity + other_capacity> operator- (const expansion<other_capacity>& other) const { return *this + (-other); }
+
+    /// Every pair of components gives an exact two-component product
+    template<size_t other_capacity>
+    expansion<2 * capacity * other_capacity> operator* (const expansion<other_capacity>& other) const {
+        expansion<2 * capacity * other_capacity> res;
+        for (size_t i = 0; i < other._size; ++i) {
+            for (size_t j = 0; j < _size; ++j) {
+                double high = _terms[j] * other._terms[i];
+                res.add(std::fma(_terms[j], other._terms[i], -high));
+                res.add(high);
+            }
+        }
+        return res;
+    }
+
+    int sign() const { return _size == 0 ? 0 : (_terms[_size - 1] > 0 ? 1 : -1); }
+
+    /// Rounded value, with the exact sign
+    double estimate() const {
+        double res = 0;
+        for (size_t i = 0; i < _size; ++i) { res += _terms[i]; }
+        return res;
+    }
+
+private:
+    template<size_t> friend class expansion;
+
+    /// Adds one double in place, keeping the components nonoverlapping. The errors are written behind
+    /// the component being read, so no second array is needed.
+    void add(double value) {
+        size_t count = 0;
+        double sum = value, error;
+        for (size_t i = 0; i < _size; ++i) {
+            two_sum(sum, _terms[i], sum, error);
+            if (error != 0) { _terms[count++] = error; }
+        }
+        if (sum != 0) { _terms[count++] = sum; }
+        _size = count;
+    }
+
+    double _terms[capacity];
+    size_t _size = 0;
+};
+
+/// Exactly a * b
+expansion<2> exact_product(double a, double b) {
+    double high = a * b;
+    return expansion<2>(high, std::fma(a, b, -high));
+}
+
+/// Exactly a - b
+expansion<2> exact_difference(double a, double b) {
+    double high, low;
+    two_sum(a, -b, high, low);
+    return expansion<2>(high, low);
+}
+
+/// Bounds on the rounding error of the plain double evaluations below, relative to the sum of magnitudes
+/// of their terms. Shewchuk's errbound A constants with epsilon = 2^-53; the circle bound is derived the same way
+/// (5 epsilon on the squared distance and 2 on the radius, rounded up).
+const double ORIENT_ERROR_BOUND = (3.0 + 16.0 * 0x1p-53) * 0x1p-53;
+const double INCIRCLE_ERROR_BOUND = (10.0 + 96.0 * 0x1p-53) * 0x1p-53;
+const double CIRCLE_ERROR_BOUND = (6.0 + 64.0 * 0x1p-53) * 0x1p-53;
+
+/// Twice the signed area of the triangle a, b, c: positive if they turn counter-clockwise, negative if
+/// clockwise, zero if collinear. The sign is always exact; the doubles are only refined when their error
+/// bound cannot rule out a wrong sign, which needs near-collinear points.
+double orient2d (const vector& a, const vector& b, const vector& c) {
+    double left = (a.x - c.x) * (b.y - c.y), right = (a.y - c.y) * (b.x - c.x);
+    double det = left - right;
+    double bound = ORIENT_ERROR_BOUND * (std::abs(left) + std::abs(right));
+    if (det > bound || -det > bound) { return det; }
+
+    auto exact = exact_product(a.x, b.y) - exact_product(a.x, c.y) - exact_product(a.y, b.x)
+               + exact_product(a.y, c.x) + exact_product(b.x, c.y) - exact_product(b.y, c.x);
+    return exact.estimate();
+}
+
+/// Positive if d lies inside the circle through the counter-clockwise a, b, c, negative outside, zero on it.
+/// Exact sign, filtered like orient2d.
+double incircle (const vector& a, const vector& b, const vector& c, const vector& d) {
+    double adx = a.x - d.x, ady = a.y - d.y, bdx = b.x - d.x, bdy = b.y - d.y, cdx = c.x - d.x, cdy = c.y - d.y;
+
+    double bc = bdx * cdy, cb = cdx * bdy, ca = cdx * ady, ac = adx * cdy, ab = adx * bdy, ba = bdx * ady;
+    double a_lift = adx * adx + ady * ady, b_lift = bdx * bdx + bdy * bdy, c_lift = cdx * cdx + cdy * cdy;
+
+    double det = a_lift * (bc - cb) + b_lift * (ca - ac) + c_lift * (ab - ba);
+    double permanent = (std::abs(bc) + std::abs(cb)) * a_lift + (std::abs(ca) + std::abs(ac)) * b_lift
+                     + (std::abs(ab) + std::abs(ba)) * c_lift;
+    double bound = INCIRCLE_ERROR_BOUND * permanent;
+    if (det > bound || -det > bound) { return det; }
+
+    expansion<2> ax = exact_difference(a.x, d.x), ay = exact_difference(a.y, d.y);
+    expansion<2> bx = exact_difference(b.x, d.x), by = exact_difference(b.y, d.y);
+    expansion<2> cx = exact_difference(c.x, d.x), cy = exact_difference(c.y, d.y);
+
+    auto exact = (ax * ax + ay * ay) * (bx * cy - cx * by)
+               + (bx * bx + by * by) * (cx * ay - ax * cy)
+               + (cx * cx + cy * cy) * (ax * by - bx * ay);
+    return exact.estimate();
+}
+
+/// Sign of |point - center|^2 - radius^2: -1 inside the circle, 0 on it, 1 outside. Exact for the given
+/// doubles, filtered like orient2d.
+int circle_side (const vector& center, double radius, const vector& point) {
+    double dx = point.x - center.x, dy = point.y - center.y;
+    double distance2 = dx * dx + dy * dy, radius2 = radius * radius;
+    double det = distance2 - radius2;
+    double bound = CIRCLE_ERROR_BOUND * (distance2 + radius2);
+    if (det > bound || -det > bound) { return det > 0 ? 1 : -1; }
+
+    expansion<2> ex = exact_difference(point.x, center.x), ey = exact_difference(point.y, center.y), r(radius, 0);
+    return (ex * ex + ey * ey - r * r).sign();
+}
+
+/// Sign of orient2d: 1 if a, b, c turn counter-clockwise, -1 if clockwise, 0 if exactly collinear
+int orientation (const vector& a, const vector& b, const vector& c) {
+    double turn = orient2d(a, b, c);
+    return (turn > 0) - (turn < 0);
+}
+
+/// Exact, unlike the EPS test on two vectors above
+bool collinear (const vector& a, const vector& b, const vector& c) { return orientation(a, b, c) == 0; }
+
+/// True if point lies on the closed segment [a, b], exactly
+bool on_segment (const vector& point, const vector& a, const vector& b) {
+    return orientation(a, b, point) == 0 && std::min(a.x, b.x) <= point.x && point.x <= std::max(a.x, b.x)
+           && std::min(a.y, b.y) <= point.y && point.y <= std::max(a.y, b.y);
+}
+
 #endif //CPP_VECTOR_H
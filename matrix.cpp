@@ -1,8 +1,151 @@
 #include <iostream>
 #include <algorithm>    // for std::min and std::max
-#include <stdexcept>    // for std::out_of_range
+#include <stdexcept>    // for std::out_of_range, std::domain_error and std::runtime_error
 #include <string>       // for std::to_string
 #include <array>
+#include <cstdint>      // for fixed-width header fields
+#include <cstring>      // for std::memcpy
+#include <fstream>
+#include <type_traits>
+
+#include <fcntl.h>      // for open
+#include <sys/mman.h>   // for mmap
+#include <sys/stat.h>   // for fstat
+#include <unistd.h>     // for close
+
+#if defined(__SSE__)
+#include <xmmintrin.h>  // for the 4x4 float inverse
+#endif
+
+/// Closed-form kernels for small square matrices stored row-major.
+/// They are branch-free and constexpr, so constant inputs are folded at compile time:
+///     constexpr std::array<double, 4> a {1, 2, 3, 4};
+///     static_assert(det2(a.data()) == -2);
+
+template<typename vt>
+constexpr vt det2(const vt* a) { return a[0] * a[3] - a[2] * a[1]; }
+
+template<typename vt>
+constexpr vt det3(const vt* a) {
+    return a[0] * (a[4] * a[8] - a[5] * a[7])
+         - a[1] * (a[3] * a[8] - a[5] * a[6])
+         + a[2] * (a[3] * a[7] - a[4] * a[6]);
+}
+
+template<typename vt>
+constexpr vt det4(const vt* a) {
+    /// 2x2 minors of the upper (s) and lower (c) row pairs, Laplace expansion over them
+    vt s0 = a[0] * a[5] - a[4] * a[1];
+    vt s1 = a[0] * a[6] - a[4] * a[2];
+    vt s2 = a[0] * a[7] - a[4] * a[3];
+    vt s3 = a[1] * a[6] - a[5] * a[2];
+    vt s4 = a[1] * a[7] - a[5] * a[3];
+    vt s5 = a[2] * a[7] - a[6] * a[3];
+
+    vt c5 = a[10] * a[15] - a[14] * a[11];
+    vt c4 = a[9] * a[15] - a[13] * a[11];
+    vt c3 = a[9] * a[14] - a[13] * a[10];
+    vt c2 = a[8] * a[15] - a[12] * a[11];
+    vt c1 = a[8] * a[14] - a[12] * a[10];
+    vt c0 = a[8] * a[13] - a[12] * a[9];
+
+    return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+}
+
+template<typename vt>
+constexpr std::array<vt, 4> adjugate2(const vt* a) { return {a[3], -a[1], -a[2], a[0]}; }
+
+template<typename vt>
+constexpr std::array<vt, 9> adjugate3(const vt* a) {
+    return {a[4] * a[8] - a[5] * a[7], a[2] * a[7] - a[1] * a[8], a[1] * a[5] - a[2] * a[4],
+            a[5] * a[6] - a[3] * a[8], a[0] * a[8] - a[2] * a[6], a[2] * a[3] - a[0] * a[5],
+            a[3] * a[7] - a[4] * a[6], a[1] * a[6] - a[0] * a[7], a[0] * a[4] - a[1] * a[3]};
+}
+
+template<typename vt>
+constexpr std::array<vt, 16> adjugate4(const vt* a) {
+    vt s0 = a[0] * a[5] - a[4] * a[1];
+    vt s1 = a[0] * a[6] - a[4] * a[2];
+    vt s2 = a[0] * a[7] - a[4] * a[3];
+    vt s3 = a[1] * a[6] - a[5] * a[2];
+    vt s4 = a[1] * a[7] - a[5] * a[3];
+    vt s5 = a[2] * a[7] - a[6] * a[3];
+
+    vt c5 = a[10] * a[15] - a[14] * a[11];
+    vt c4 = a[9] * a[15] - a[13] * a[11];
+    vt c3 = a[9] * a[14] - a[13] * a[10];
+    vt c2 = a[8] * a[15] - a[12] * a[11];
+    vt c1 = a[8] * a[14] - a[12] * a[10];
+    vt c0 = a[8] * a[13] - a[12] * a[9];
+
+    return {a[5] * c5 - a[6] * c4 + a[7] * c3,
+            -a[1] * c5 + a[2] * c4 - a[3] * c3,
+            a[13] * s5 - a[14] * s4 + a[15] * s3,
+            -a[9] * s5 + a[10] * s4 - a[11] * s3,
+
+            -a[4] * c5 + a[6] * c2 - a[7] * c1,
+            a[0] * c5 - a[2] * c2 + a[3] * c1,
+            -a[12] * s5 + a[14] * s2 - a[15] * s1,
+            a[8] * s5 - a[10] * s2 + a[11] * s1,
+
+            a[4] * c4 - a[5] * c2 + a[7] * c0,
+            -a[0] * c4 + a[1] * c2 - a[3] * c0,
+            a[12] * s4 - a[13] * s2 + a[15] * s0,
+            -a[8] * s4 + a[9] * s2 - a[11] * s0,
+
+            -a[4] * c3 + a[5] * c1 - a[6] * c0,
+            a[0] * c3 - a[1] * c1 + a[2] * c0,
+            -a[12] * s3 + a[13] * s1 - a[14] * s0,
+            a[8] * s3 - a[9] * s1 + a[10] * s0};
+}
+
+#if defined(__SSE__)
+/// Writes the inverse of a row-major 4x4 float matrix to `res` and returns its determinant.
+/// Same expansion as adjugate4(), four cofactors per instruction.
+inline float inverse4_sse(const float* a, float* res) {
+    __m128 col0 = _mm_loadu_ps(a);
+    __m128 col1 = _mm_loadu_ps(a + 4);
+    __m128 col2 = _mm_loadu_ps(a + 8);
+    __m128 col3 = _mm_loadu_ps(a + 12);
+    _MM_TRANSPOSE4_PS(col0, col1, col2, col3);
+
+    /// v_j = {a1j, a0j, a3j, a2j}
+    __m128 v0 = _mm_shuffle_ps(col0, col0, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 v1 = _mm_shuffle_ps(col1, col1, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 v2 = _mm_shuffle_ps(col2, col2, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 v3 = _mm_shuffle_ps(col3, col3, _MM_SHUFFLE(2, 3, 0, 1));
+
+    /// {c, c, s, s} for the column pair (p, q), where s and c are its upper and lower 2x2 minors
+    auto minors = [](__m128 col_p, __m128 v_q) {
+        __m128 prod = _mm_mul_ps(col_p, v_q);
+        __m128 diff = _mm_sub_ps(prod, _mm_shuffle_ps(prod, prod, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_shuffle_ps(diff, diff, _MM_SHUFFLE(0, 0, 2, 2));
+    };
+    __m128 m01 = minors(col0, v1);
+    __m128 m02 = minors(col0, v2);
+    __m128 m03 = minors(col0, v3);
+    __m128 m12 = minors(col1, v2);
+    __m128 m13 = minors(col1, v3);
+    __m128 m23 = minors(col2, v3);
+
+    const __m128 sign = _mm_setr_ps(1.f, -1.f, 1.f, -1.f);
+    __m128 row0 = _mm_mul_ps(sign, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(v1, m23), _mm_mul_ps(v2, m13)), _mm_mul_ps(v3, m12)));
+    __m128 row1 = _mm_mul_ps(sign, _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(v2, m03), _mm_mul_ps(v0, m23)), _mm_mul_ps(v3, m02)));
+    __m128 row2 = _mm_mul_ps(sign, _mm_add_ps(_mm_sub_ps(_mm_mul_ps(v0, m13), _mm_mul_ps(v1, m03)), _mm_mul_ps(v3, m01)));
+    __m128 row3 = _mm_mul_ps(sign, _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(v1, m02), _mm_mul_ps(v0, m12)), _mm_mul_ps(v2, m01)));
+
+    float det = a[0] * _mm_cvtss_f32(row0) + a[1] * _mm_cvtss_f32(row1)
+              + a[2] * _mm_cvtss_f32(row2) + a[3] * _mm_cvtss_f32(row3);
+
+    __m128 inv_det = _mm_set1_ps(1.f / det);
+    _mm_storeu_ps(res, _mm_mul_ps(row0, inv_det));
+    _mm_storeu_ps(res + 4, _mm_mul_ps(row1, inv_det));
+    _mm_storeu_ps(res + 8, _mm_mul_ps(row2, inv_det));
+    _mm_storeu_ps(res + 12, _mm_mul_ps(row3, inv_det));
+
+    return det;
+}
+#endif
 
 template<typename vt, size_t height, size_t width>
 class matrix {
@@ -54,6 +197,12 @@ public:
     vt& at(const size_t& i, const size_t& j) { return _matrix[i * width + j]; }
     const vt& at(const size_t& i, const size_t& j) const { return _matrix[i * width + j]; }
 
+    vt* data() { return _matrix; }
+    const vt* data() const { return _matrix; }
+
+    void save(const std::string& path) const;
+    static matrix load(const std::string& path);
+
     matrix<vt, width, height> transposed() const {
         matrix<vt, width, height> matrix_T;
 
@@ -96,17 +245,66 @@ public:
     }
 
     vt det() const {
-        /// Det = SUM_j=1^n (-1)^(1+j) * a_1_j * M_j^1
-        if (height == 2) { return (*this)(0, 0) * (*this)(1, 1) - (*this)(1, 0) * (*this)(0, 1); }
+        static_assert(height == width, "Determinant is defined only for square matrices");
 
-        vt sum = 0;
+        if constexpr (height == 1) { return _matrix[0]; }
+        else if constexpr (height == 2) { return det2(_matrix); }
+        else if constexpr (height == 3) { return det3(_matrix); }
+        else if constexpr (height == 4) { return det4(_matrix); }
+        else {
+            /// Det = SUM_j=1^n (-1)^(1+j) * a_1_j * M_j^1
+            vt sum = 0;
 
-        for (size_t j = 0; j < width; ++j) {
-            int sgn = (j % 2) ? -1 : 1;
-            sum += sgn * _matrix[0 + j] * Minor(0, j).det();
+            for (size_t j = 0; j < width; ++j) {
+                int sgn = (j % 2) ? -1 : 1;
+                sum += sgn * _matrix[0 + j] * Minor(0, j).det();
+            }
+
+            return sum;
         }
+    }
 
-        return sum;
+    matrix adjugate() const {
+        static_assert(height == width, "Adjugate is defined only for square matrices");
+
+        matrix res;
+        if constexpr (height == 1) { res(0, 0) = 1; }
+        else if constexpr (height == 2) { write_closed_form(res, adjugate2(_matrix)); }
+        else if constexpr (height == 3) { write_closed_form(res, adjugate3(_matrix)); }
+        else if constexpr (height == 4) { write_closed_form(res, adjugate4(_matrix)); }
+        else {
+            /// adj(A)_i_j = (-1)^(i+j) * M_j^i
+            for (size_t i = 0; i < height; ++i) {
+                for (size_t j = 0; j < width; ++j) {
+                    int sgn = ((i + j) % 2) ? -1 : 1;
+                    res(i, j) = sgn * Minor(j, i).det();
+                }
+            }
+        }
+
+        return res;
+    }
+
+    /// Integer matrices have no inverse in their own type unless det is +-1; use adjugate() and det() instead
+    matrix inverse() const {
+        static_assert(height == width, "Inverse is defined only for square matrices");
+        static_assert(std::is_floating_point<vt>::value, "Inverse needs a floating-point value type, use adjugate() and det()");
+#if defined(__SSE__)
+        if constexpr (height == 4 && width == 4 && std::is_same<vt, float>::value) {
+            matrix res;
+            if (inverse4_sse(_matrix, res._matrix) == 0) { throw std::domain_error("Error: Matrix is singular!"); }
+            return res;
+        }
+#endif
+        vt d = det();
+        if (d == 0) { throw std::domain_error("Error: Matrix is singular!"); }
+
+        matrix res = adjugate();
+        for (size_t i = 0; i < height * width; ++i) {
+            res._matrix[i] /= d;
+        }
+
+        return res;
     }
 
     template<typename vt2, size_t x, size_t y>
@@ -178,6 +376,13 @@ public:
     const matrix operator+ () const { return *this; }
 
 private:
+    template<size_t count>
+    static void write_closed_form(matrix& res, const std::array<vt, count>& values) {
+        for (size_t i = 0; i < count; ++i) {
+            res._matrix[i] = values[i];
+        }
+    }
+
     vt * _matrix;
 };
 
@@ -252,6 +457,229 @@ matrix<vt, height, width> operator* (const vt2 num, const matrix<vt, height, wid
 }
 
 
+/// Binary matrix format:
+///   [matrix_file_header][padding up to data_offset][height * width values, row-major]
+/// Values are stored in the byte order of the writer; the order is recorded in the header
+/// so that a reader can detect (and for load() undo) a mismatch. data_offset is a multiple
+/// of MATRIX_FILE_ALIGNMENT, so a mapped file can be read in place.
+
+const size_t MATRIX_FILE_ALIGNMENT = 64;
+const uint32_t MATRIX_FILE_MAGIC = 0x5854414d;      // "MATX"
+const uint32_t MATRIX_FILE_BYTE_ORDER = 0x01020304;
+
+enum class matrix_value_kind : uint8_t { unsigned_int = 0, signed_int = 1, floating = 2 };
+
+struct matrix_file_header {
+    uint32_t magic;
+    uint32_t byte_order;
+    uint8_t value_kind;
+    uint8_t value_size;
+    uint16_t reserved;
+    uint32_t alignment;
+    uint64_t height;
+    uint64_t width;
+    uint64_t data_offset;
+};
+
+template<typename vt>
+matrix_file_header make_matrix_header(size_t height, size_t width) {
+    static_assert(std::is_arithmetic<vt>::value, "Only arithmetic matrices can be serialized");
+
+    matrix_file_header header{};
+    header.magic = MATRIX_FILE_MAGIC;
+    header.byte_order = MATRIX_FILE_BYTE_ORDER;
+    header.value_kind = static_cast<uint8_t>(std::is_floating_point<vt>::value ? matrix_value_kind::floating
+                                             : std::is_signed<vt>::value ? matrix_value_kind::signed_int
+                                             : matrix_value_kind::unsigned_int);
+    header.value_size = sizeof(vt);
+    header.alignment = MATRIX_FILE_ALIGNMENT;
+    header.height = height;
+    header.width = width;
+    header.data_offset = (sizeof(matrix_file_header) + MATRIX_FILE_ALIGNMENT - 1) / MATRIX_FILE_ALIGNMENT * MATRIX_FILE_ALIGNMENT;
+    return header;
+}
+
+uint32_t byte_swap(uint32_t num) {
+    return ((num & 0xff) << 24) | ((num & 0xff00) << 8) | ((num >> 8) & 0xff00) | (num >> 24);
+}
+
+/// Returns true if the file was written with the opposite byte order
+template<typename vt>
+bool check_matrix_header(const matrix_file_header& header, size_t height, size_t width) {
+    matrix_file_header expected = make_matrix_header<vt>(height, width);
+
+    bool swapped = header.byte_order != MATRIX_FILE_BYTE_ORDER;
+    if (header.magic != expected.magic && byte_swap(header.magic) != expected.magic) {
+        throw std::runtime_error("Error: Not a matrix file!");
+    }
+    if (swapped && byte_swap(header.byte_order) != MATRIX_FILE_BYTE_ORDER) {
+        throw std::runtime_error("Error: Unknown byte order in matrix file!");
+    }
+    if (header.value_kind != expected.value_kind || header.value_size != expected.value_size) {
+        throw std::runtime_error("Error: Matrix file holds values of another type!");
+    }
+    if (swapped) { return true; }  // the remaining fields would need swapping too, load() handles it
+
+    if (header.height != height || header.width != width) {
+        throw std::runtime_error("Error: Matrix file has different sizes: " + std::to_string(header.height) + "x" + std::to_string(header.width));
+    }
+    if (header.data_offset % MATRIX_FILE_ALIGNMENT != 0) {
+        throw std::runtime_error("Error: Matrix file data is not aligned!");
+    }
+
+    return false;
+}
+
+template<typename vt>
+void byte_swap_values(vt* values, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        unsigned char* bytes = reinterpret_cast<unsigned char*>(values + i);
+        std::reverse(bytes, bytes + sizeof(vt));
+    }
+}
+
+/// Streams a matrix into a file in row chunks, so the whole matrix never has to be in memory
+template<typename vt, size_t height, size_t width>
+class matrix_writer {
+public:
+    explicit matrix_writer(const std::string& path): _file(path, std::ios::binary | std::ios::trunc), _rows_written(0) {
+        if (!_file) { throw std::runtime_error("Error: Cannot open " + path + " for writing!"); }
+
+        matrix_file_header header = make_matrix_header<vt>(height, width);
+        char padding[MATRIX_FILE_ALIGNMENT] = {};
+        _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        _file.write(padding, header.data_offset - sizeof(header));
+    }
+
+    matrix_writer(const matrix_writer& other) = delete;
+    matrix_writer& operator= (const matrix_writer& other) = delete;
+    ~matrix_writer() = default;
+
+    /// Appends `count` full rows stored contiguously in `rows`
+    void write_rows(const vt* rows, size_t count) {
+        if (_rows_written + count > height) {
+            throw std::out_of_range("Error: Too many rows written to the matrix file!");
+        }
+
+        _file.write(reinterpret_cast<const char*>(rows), count * width * sizeof(vt));
+        if (!_file) { throw std::runtime_error("Error: Failed to write matrix rows!"); }
+        _rows_written += count;
+    }
+
+    void close() {
+        if (_rows_written != height) {
+            throw std::runtime_error("Error: Matrix file is incomplete, " + std::to_string(_rows_written) + " rows written!");
+        }
+
+        _file.close();
+    }
+
+    size_t rows_written() const { return _rows_written; }
+
+private:
+    std::ofstream _file;
+    size_t _rows_written;
+};
+
+/// Read-only matrix backed by a memory-mapped file. Values are never copied.
+template<typename vt, size_t height, size_t width>
+class mapped_matrix {
+public:
+    explicit mapped_matrix(const std::string& path): _mapping(nullptr), _size(0), _matrix(nullptr) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) { throw std::runtime_error("Error: Cannot open " + path + "!"); }
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(matrix_file_header)) {
+            ::close(fd);
+            throw std::runtime_error("Error: " + path + " is too small to be a matrix file!");
+        }
+
+        _size = st.st_size;
+        _mapping = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (_mapping == MAP_FAILED) { throw std::runtime_error("Error: Cannot map " + path + "!"); }
+
+        const matrix_file_header* header = static_cast<const matrix_file_header*>(_mapping);
+        try {
+            if (check_matrix_header<vt>(*header, height, width)) {
+                throw std::runtime_error("Error: Matrix file has foreign byte order, use matrix::load()!");
+            }
+            if (_size < header->data_offset + height * width * sizeof(vt)) {
+                throw std::runtime_error("Error: Matrix file is truncated!");
+            }
+        } catch (...) {
+            munmap(_mapping, _size);
+            throw;
+        }
+
+        _matrix = reinterpret_cast<const vt*>(static_cast<const char*>(_mapping) + header->data_offset);
+    }
+
+    mapped_matrix(mapped_matrix&& other) noexcept: _mapping(other._mapping), _size(other._size), _matrix(other._matrix) {
+        other._mapping = nullptr;
+        other._matrix = nullptr;
+    }
+
+    mapped_matrix(const mapped_matrix& other) = delete;
+    mapped_matrix& operator= (const mapped_matrix& other) = delete;
+
+    ~mapped_matrix() {
+        if (_mapping != nullptr) { munmap(_mapping, _size); }
+    }
+
+    const vt& operator() (const size_t& i, const size_t& j) const { return _matrix[i * width + j]; }
+    const vt& at(const size_t& i, const size_t& j) const { return _matrix[i * width + j]; }
+    const vt* data() const { return _matrix; }
+
+    matrix<vt, height, width> to_matrix() const {
+        matrix<vt, height, width> res;
+        std::memcpy(res.data(), _matrix, height * width * sizeof(vt));
+        return res;
+    }
+
+private:
+    void* _mapping;
+    size_t _size;
+    const vt* _matrix;
+};
+
+template<typename vt, size_t height, size_t width>
+void matrix<vt, height, width>::save(const std::string& path) const {
+    matrix_writer<vt, height, width> writer(path);
+    writer.write_rows(_matrix, height);
+    writer.close();
+}
+
+template<typename vt, size_t height, size_t width>
+matrix<vt, height, width> matrix<vt, height, width>::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) { throw std::runtime_error("Error: Cannot open " + path + "!"); }
+
+    matrix_file_header header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file) { throw std::runtime_error("Error: " + path + " is too small to be a matrix file!"); }
+
+    bool swapped = check_matrix_header<vt>(header, height, width);
+    if (swapped) {
+        byte_swap_values(&header.height, 1);
+        byte_swap_values(&header.width, 1);
+        byte_swap_values(&header.data_offset, 1);
+        check_matrix_header<vt>(matrix_file_header{MATRIX_FILE_MAGIC, MATRIX_FILE_BYTE_ORDER, header.value_kind, header.value_size,
+                                                   0, MATRIX_FILE_ALIGNMENT, header.height, header.width, header.data_offset}, height, width);
+    }
+
+    matrix res;
+    file.seekg(header.data_offset);
+    file.read(reinterpret_cast<char*>(res._matrix), height * width * sizeof(vt));
+    if (!file) { throw std::runtime_error("Error: Matrix file is truncated!"); }
+
+    if (swapped) { byte_swap_values(res._matrix, height * width); }
+    return res;
+}
+
+
+#ifndef CPP_NO_MAIN
 int main() {
 #define len 6
     matrix<int, len, len> A;
@@ -276,3 +704,4 @@ int main() {
 
     return 0;
 }
+#endif //CPP_NO_MAIN
@@ -1,191 +1,1293 @@
-#include <iostream>
-
-template<size_t length>
-class permutation {
-public:
-    permutation() {
-        _perm = new unsigned[length];
-        for (size_t i = 0; i < length; ++i) {
-            _perm[i] = i;
-        }
-    }
-
-    explicit permutation(const unsigned* array) {
-        _perm = new unsigned[length];
-        for (size_t i = 0; i < length; ++i) {
-            _perm[i] = array[i];
-        }
-    }
-
-    permutation(const permutation& other) {
-        _perm = new unsigned[length];
-        for (size_t i = 0; i < length; ++i) {
-            _perm[i] = other[i];
-        }
-    }
-
-    ~permutation() { delete _perm; }
-
-    permutation& operator= (const permutation& other) {
-        if (this != &other) {
-            for (size_t i = 0; i < length; ++i) {
-                _perm[i] = other[i];
-            }
-        }
-
-        return *this;
-    }
-
-    unsigned& operator[] (size_t i) { return _perm[i]; }
-    const unsigned& operator[] (size_t i) const { return _perm[i]; }
-
-    permutation& operator*= (const permutation& other) {
-        permutation<length> res;
-
-        for (size_t i = 0; i < length; ++i) {
-            res[i] = _perm[other[i]];
-        }
-
-        *this = res;
-        return *this;
-    }
-
-    permutation& operator++ () { return *this = (*this).next(); }
-    permutation& operator-- () { return *this = (*this).prev(); }
-
-    const permutation operator++ (int) {
-        permutation tmp = *this;
-        *this = (*this).next();
-        return tmp;
-    }
-
-    const permutation operator-- (int) {
-        permutation tmp = *this;
-        *this = (*this).prev();
-        return tmp;
-    }
-
-    void operator() (unsigned* values) const {
-        unsigned* val_cp = new unsigned[length];
-
-        for (size_t i = 0; i < length; ++i) {
-            val_cp[i] = values[i];
-        }
-
-        for (size_t i = 0; i < length; ++i) {
-            values[_perm[i]] = val_cp[i];
-        }
-    }
-
-    permutation next() const {
-        permutation<length> res = *this;
-
-        int point1 = length - 1;
-        while (point1 > 0 && res[point1 - 1] >= res[point1]) { --point1; }
-
-        if (point1 == 0) { return permutation<length>(); }
-
-        int point2 = length - 1;
-        while (res[point2] <= res[point1 - 1]) { point2--; }
-
-        // pivots are on indexes: (point1 - 1) and (point2)
-        std::swap(res[point1 - 1], res[point2]);
-
-        for (int i = length - 1; i > point1; i--, point1++) {
-            std::swap(res[point1], res[i]);
-        }
-
-        return res;
-    }
-
-    permutation inverse() const {
-        permutation<length> res = *this;
-
-        for (unsigned i = 0; i < length; ++i) {
-            res[_perm[i]] = i;
-        }
-
-        return res;
-    }
-
-    permutation prev() const {
-        permutation<length> res = *this;
-
-        int point1 = length - 1;
-        while (point1 > 0 && res[point1 - 1] <= res[point1]) { --point1; }
-
-        if (point1 == 0) {
-            for (int i = length - 1; i >= 0; --i) {
-                res[length - i - 1] = i;
-            }
-            return res;
-        }
-
-        int point2 = length - 1;
-        while (res[point2] >= res[point1 - 1]) { point2--; }
-
-        // pivots are on indexes: (point1 - 1) and (point2)
-        std::swap(res[point1 - 1], res[point2]);
-
-        for (int i = length - 1; i > point1; i--, point1++) {
-            std::swap(res[point1], res[i]);
-        }
-
-        return res;
-    }
-
-private:
-    unsigned* _perm;
-};
-
-template<size_t length1, size_t length2>
-bool operator<(const permutation<length1> &lhs, const permutation<length2> &rhs) {
-    for (size_t i = 0; (i < length1) && (i < length2); ++i) {
-        if (lhs[i] > rhs[i]) { return false; }
-        else if (lhs[i] < rhs[i]) { return true; }
-    }
-
-    return length1 < length2;
-}
-
-template<size_t length1, size_t length2>
-bool operator==(const permutation<length1> &lhs, const permutation<length2> &rhs) {
-    for (size_t i = 0; (i < length1) && (i < length2); ++i) {
-        if (lhs[i] != rhs[i]) { return false; }
-    }
-
-    return length1 == length2;
-}
-
-template<size_t length1, size_t length2>
-bool operator<= (const permutation<length1> &lhs, const permutation<length2> &rhs) { return (lhs < rhs) || (lhs == rhs); }
-
-template<size_t length1, size_t length2>
-bool operator> (const permutation<length1> &lhs, const permutation<length2> &rhs) { return !(lhs <= rhs); }
-
-template<size_t length1, size_t length2>
-bool operator>= (const permutation<length1> &lhs, const permutation<length2> &rhs) { return !(lhs < rhs); }
-
-template<size_t length1, size_t length2>
-bool operator!= (const permutation<length1> &lhs, const permutation<length2> &rhs) { return !(lhs == rhs); }
-
-template<size_t length>
-permutation<length> operator* (const permutation<length>& first, const permutation<length>& second) { return permutation<length>(first) *= second; }
-
-
-int main() {
-    permutation<3> A;
-
-    for (int i = 0; i < 3; ++i) {
-        std::cout << A[i] << " ";
-    }
-    std::cout << std::endl;
-
-    --A;
-
-    for (int i = 0; i < 3; ++i) {
-        std::cout << A[i] << " ";
-    }
-
-    return 0;
-}
+#include <iostream>
+#include <algorithm>    // for std::copy
+#include <array>
+#include <bitset>       // for the visited marks of an in-place apply
+#include <cstdint>      // for the compact index types
+#include <cstring>      // for std::memcpy
+#include <exception>    // for passing worker errors to the caller
+#include <functional>   // for std::hash
+#include <memory>       // for std::unique_ptr
+#include <stdexcept>    // for std::overflow_error, std::length_error, std::invalid_argument and std::out_of_range
+#include <string>       // for std::to_string
+#include <thread>
+#include <type_traits>
+#include <utility>      // for std::exchange
+#include <vector>
+
+#if defined(__AVX2__) || defined(__AVX512F__) || defined(__BMI2__)
+#include <immintrin.h>  // for gathers and byte permutes in compose_indices, pdep in unrank
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>  // for the nibble shuffle in packed_permutation
+#elif defined(__SSE2__)
+#include <emmintrin.h>  // for streaming stores in partition_pairs
+#endif
+
+/// Smallest unsigned type that can hold every index of a permutation of `length` elements
+template<size_t length>
+using permutation_index_t = typename std::conditional<(length <= 0x100), uint8_t,
+                            typename std::conditional<(length <= 0x10000), uint16_t, uint32_t>::type>::type;
+
+/// Permutations up to this size are stored inside the object, larger ones on the heap
+const size_t PERMUTATION_INLINE_BYTES = 512;
+
+template<typename index_type, size_t length, bool is_inline = (length * sizeof(index_type) <= PERMUTATION_INLINE_BYTES)>
+class permutation_storage {
+public:
+    index_type* data() { return _data.data(); }
+    const index_type* data() const { return _data.data(); }
+
+    void swap(permutation_storage& other) { _data.swap(other._data); }
+
+private:
+    std::array<index_type, length> _data;
+};
+
+template<typename index_type, size_t length>
+class permutation_storage<index_type, length, false> {
+public:
+    permutation_storage(): _data(new index_type[length]) {}
+
+    permutation_storage(const permutation_storage& other): _data(new index_type[length]) {
+        std::copy(other._data, other._data + length, _data);
+    }
+
+    permutation_storage& operator= (const permutation_storage& other) {
+        if (this != &other) {
+            std::copy(other._data, other._data + length, _data);
+        }
+
+        return *this;
+    }
+
+    ~permutation_storage() { delete[] _data; }
+
+    index_type* data() { return _data; }
+    const index_type* data() const { return _data; }
+
+    void swap(permutation_storage& other) { std::swap(_data, other._data); }
+
+private:
+    index_type* _data;
+};
+
+/// out[i] = lhs[rhs[i]] for i < count. `out` must not alias either input.
+/// Small byte-indexed permutations are composed with one table shuffle, 32-bit ones with gathers.
+template<typename index_type>
+void compose_indices(const index_type* lhs, const index_type* rhs, index_type* out, size_t count) {
+#if defined(__AVX512VBMI__)
+    if constexpr (std::is_same<index_type, uint8_t>::value) {
+        if (count <= 128) {
+            /// vpermi2b: 7-bit indices select from the 128-byte table {table_lo, table_hi}
+            __m512i table_lo = _mm512_maskz_loadu_epi8(count >= 64 ? ~0ull : (1ull << count) - 1, lhs);
+            __m512i table_hi = count <= 64 ? _mm512_setzero_si512()
+                                           : _mm512_maskz_loadu_epi8(count == 128 ? ~0ull : (1ull << (count - 64)) - 1, lhs + 64);
+            __m512i res[2];
+            for (size_t i = 0; i < count; i += 64) {
+                __mmask64 mask = count - i >= 64 ? ~0ull : (1ull << (count - i)) - 1;
+                __m512i idx = _mm512_maskz_loadu_epi8(mask, rhs + i);
+                res[i / 64] = _mm512_permutex2var_epi8(table_lo, idx, table_hi);
+            }
+            for (size_t i = 0; i < count; i += 64) {
+                _mm512_mask_storeu_epi8(out + i, count - i >= 64 ? ~0ull : (1ull << (count - i)) - 1, res[i / 64]);
+            }
+            return;
+        }
+    }
+#elif defined(__SSSE3__)
+    if constexpr (std::is_same<index_type, uint8_t>::value) {
+        if (count <= 16) {
+            alignas(16) uint8_t table[16] = {};
+            alignas(16) uint8_t idx[16] = {};
+            std::copy(lhs, lhs + count, table);
+            std::copy(rhs, rhs + count, idx);
+            __m128i res = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(table)),
+                                           _mm_load_si128(reinterpret_cast<const __m128i*>(idx)));
+            _mm_store_si128(reinterpret_cast<__m128i*>(table), res);
+            std::copy(table, table + count, out);
+            return;
+        }
+    }
+#endif
+#if defined(__AVX2__)
+    if constexpr (std::is_same<index_type, uint32_t>::value) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rhs + i));
+            __m256i res = _mm256_i32gather_epi32(reinterpret_cast<const int*>(lhs), idx, 4);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), res);
+        }
+        for (; i < count; ++i) {
+            out[i] = lhs[rhs[i]];
+        }
+        return;
+    }
+#endif
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = lhs[rhs[i]];
+    }
+}
+
+/// out[perm[i]] = i for i < count. `out` must not alias `perm`.
+template<typename index_type>
+void invert_indices(const index_type* perm, index_type* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        out[perm[i]] = i;
+    }
+}
+
+/// Steps to the next permutation in lexicographic order in place, touching only the changed suffix.
+/// Returns false when wrapping around from the last permutation to the identity.
+template<typename index_type>
+bool advance_indices(index_type* perm, size_t count) {
+    if (count < 2) { return false; }
+
+    size_t point1 = count - 1;
+    while (point1 > 0 && perm[point1 - 1] >= perm[point1]) { --point1; }
+
+    if (point1 == 0) {
+        std::reverse(perm, perm + count);
+        return false;
+    }
+
+    size_t point2 = count - 1;
+    while (perm[point2] <= perm[point1 - 1]) { point2--; }
+
+    // pivots are on indexes: (point1 - 1) and (point2)
+    std::swap(perm[point1 - 1], perm[point2]);
+    std::reverse(perm + point1, perm + count);
+    return true;
+}
+
+/// Steps to the previous permutation in place.
+/// Returns false when wrapping around from the identity to the last permutation.
+template<typename index_type>
+bool retreat_indices(index_type* perm, size_t count) {
+    if (count < 2) { return false; }
+
+    size_t point1 = count - 1;
+    while (point1 > 0 && perm[point1 - 1] <= perm[point1]) { --point1; }
+
+    if (point1 == 0) {
+        std::reverse(perm, perm + count);
+        return false;
+    }
+
+    size_t point2 = count - 1;
+    while (perm[point2] >= perm[point1 - 1]) { point2--; }
+
+    // pivots are on indexes: (point1 - 1) and (point2)
+    std::swap(perm[point1 - 1], perm[point2]);
+    std::reverse(perm + point1, perm + count);
+    return true;
+}
+
+/// Moves values[i] to values[perm[i]] in place, walking each cycle once. `visited` starts all false.
+template<typename index_type, typename value_type, typename marks>
+void apply_cycles(const index_type* perm, size_t count, value_type* values, marks& visited) {
+    for (size_t i = 0; i < count; ++i) {
+        if (visited[i]) { continue; }
+
+        value_type carry = std::move(values[i]);
+        for (size_t j = perm[i]; j != i; j = perm[j]) {
+            std::swap(carry, values[j]);
+            visited[j] = true;
+        }
+        values[i] = std::move(carry);
+        visited[i] = true;
+    }
+}
+
+/// Same result as apply_cycles(), moving the values through `scratch` instead of marking cycles
+template<typename index_type, typename value_type>
+void apply_scatter(const index_type* perm, size_t count, value_type* values, value_type* scratch) {
+    std::move(values, values + count, scratch);
+
+    for (size_t i = 0; i < count; ++i) {
+        values[perm[i]] = std::move(scratch[i]);
+    }
+}
+
+/// Runs fn(t) for t in [0, threads) on separate threads (t = 0 on the calling one)
+/// and rethrows the first exception any of them threw
+template<typename function>
+void run_parallel(unsigned threads, function fn) {
+    std::vector<std::exception_ptr> errors(threads);
+    auto worker = [&](unsigned t) {
+        try {
+            fn(t);
+        } catch (...) {
+            errors[t] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) {
+        pool.emplace_back(worker, t);
+    }
+    worker(0);
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    for (auto& error : errors) {
+        if (error) { std::rethrow_exception(error); }
+    }
+}
+
+/// log2 of the destination range handled per bucket; 64K 32-bit entries keep a bucket in L2
+const size_t PERMUTATION_BLOCK_SHIFT = 16;
+
+template<typename index_type>
+struct index_pair {
+    index_type key;
+    index_type value;
+};
+
+/// Position of `pair` within its 64-byte cache line, in whole pairs. A caller's scratch only has the
+/// alignment of index_type, so a pair may straddle the line start; it then counts as position 0.
+template<typename index_type>
+size_t line_offset(const index_pair<index_type>* pair) {
+    return (reinterpret_cast<uintptr_t>(pair) % 64) / sizeof(index_pair<index_type>);
+}
+
+/// Writes the staged pairs from line_offset(dst) to the end of the line to `dst`, returns their count.
+/// Whole lines are streamed only when `dst` is the line start itself; otherwise they are copied.
+template<typename index_type>
+size_t flush_line(const index_pair<index_type>* stage, index_pair<index_type>* dst) {
+    const size_t line = 64 / sizeof(index_pair<index_type>);
+    size_t first = line_offset(dst);
+
+#if defined(__SSE2__)
+    if (reinterpret_cast<uintptr_t>(dst) % 64 == 0) {
+        const __m128i* src = reinterpret_cast<const __m128i*>(stage);
+        __m128i* out = reinterpret_cast<__m128i*>(dst);
+        for (size_t i = 0; i < 4; ++i) {
+            _mm_stream_si128(out + i, _mm_load_si128(src + i));
+        }
+        return line;
+    }
+#endif
+    std::copy(stage + first, stage + line, dst);
+    return line - first;
+}
+
+/// Writes {key(j), value(j)} for j < count into `dst`, grouped by key >> PERMUTATION_BLOCK_SHIFT.
+/// The keys must be a permutation of [0, count).
+/// `bucket_begin` receives the start of every bucket in `dst`, plus the end.
+/// The writes go to a few hundred sequential streams instead of `count` random places.
+template<typename index_type, typename key_function, typename value_function>
+void partition_pairs(size_t count, key_function key, value_function value, index_pair<index_type>* dst,
+                     std::vector<size_t>& bucket_begin, unsigned threads) {
+    size_t buckets = ((count - 1) >> PERMUTATION_BLOCK_SHIFT) + 1;
+
+    std::vector<std::vector<size_t>> offsets(threads, std::vector<size_t>(buckets, 0));
+    if (threads == 1) {
+        /// The keys are a permutation of [0, count), so every bucket but the last is full
+        for (size_t b = 0; b < buckets; ++b) {
+            offsets[0][b] = std::min(count - (b << PERMUTATION_BLOCK_SHIFT), size_t(1) << PERMUTATION_BLOCK_SHIFT);
+        }
+    } else {
+        run_parallel(threads, [&](unsigned t) {
+            size_t* histogram = offsets[t].data();
+            size_t first = count * t / threads, last = count * (t + 1) / threads;
+            for (size_t j = first; j < last; ++j) {
+                ++histogram[key(j) >> PERMUTATION_BLOCK_SHIFT];
+            }
+        });
+    }
+
+    bucket_begin.assign(buckets + 1, 0);
+    size_t position = 0;
+    for (size_t b = 0; b < buckets; ++b) {
+        bucket_begin[b] = position;
+        for (unsigned t = 0; t < threads; ++t) {
+            position += std::exchange(offsets[t][b], position);
+        }
+    }
+    bucket_begin[buckets] = position;
+
+    /// Pairs are staged per bucket in one cache line and written out a whole line at a time with
+    /// non-temporal stores, so the bucket streams neither read their destination nor evict the input
+    const size_t line = 64 / sizeof(index_pair<index_type>);
+    run_parallel(threads, [&](unsigned t) {
+        size_t* cursor = offsets[t].data();
+        std::vector<index_pair<index_type>> staged_storage((buckets + 1) * line);
+        index_pair<index_type>* staged = staged_storage.data() + (line - line_offset(staged_storage.data())) % line;
+        std::vector<size_t> staged_count_storage(buckets);
+        size_t* staged_count = staged_count_storage.data();
+        for (size_t b = 0; b < buckets; ++b) {
+            staged_count[b] = line_offset(dst + cursor[b]);
+        }
+
+        size_t first = count * t / threads, last = count * (t + 1) / threads;
+        for (size_t j = first; j < last; ++j) {
+            index_type k = key(j);
+            size_t b = k >> PERMUTATION_BLOCK_SHIFT;
+            index_pair<index_type>* stage = staged + b * line;
+
+            stage[staged_count[b]++] = index_pair<index_type>{k, static_cast<index_type>(value(j))};
+            if (staged_count[b] == line) {
+                cursor[b] += flush_line(stage, dst + cursor[b]);
+                staged_count[b] = 0;
+            }
+        }
+
+        for (size_t b = 0; b < buckets; ++b) {
+            size_t offset = line_offset(dst + cursor[b]);
+            std::copy(staged + b * line + offset, staged + b * line + staged_count[b], dst + cursor[b]);
+        }
+#if defined(__SSE2__)
+        _mm_sfence();
+#endif
+    });
+}
+
+/// out[key] = value for the partitioned pairs, one destination range at a time
+template<typename index_type>
+void scatter_buckets(const index_pair<index_type>* pairs, const std::vector<size_t>& bucket_begin, index_type* out, unsigned threads) {
+    size_t buckets = bucket_begin.size() - 1;
+    run_parallel(threads, [&](unsigned t) {
+        size_t first = buckets * t / threads, last = buckets * (t + 1) / threads;
+        for (size_t j = bucket_begin[first]; j < bucket_begin[last]; ++j) {
+            out[pairs[j].key] = pairs[j].value;
+        }
+    });
+}
+
+/// invert_indices() for huge permutations: the pairs {perm[i], i} are first partitioned by destination
+/// range, then every range is filled while it sits in cache. Buckets are spread over `threads`.
+/// `scratch` may supply room for `count` pairs to reuse between calls; otherwise it is allocated.
+/// The permutation types do not use it: it only beats invert_indices() from about 10^7 entries with
+/// a reused scratch, see the permutation/huge_* cases in benchmark.cpp.
+template<typename index_type>
+void invert_indices_blocked(const index_type* perm, index_type* out, size_t count, unsigned threads = 1,
+                            index_pair<index_type>* scratch = nullptr) {
+    if (count == 0) { return; }
+
+    std::unique_ptr<index_pair<index_type>[]> allocated(scratch ? nullptr : new index_pair<index_type>[count]);
+    index_pair<index_type>* pairs = scratch ? scratch : allocated.get();
+
+    std::vector<size_t> bucket_begin;
+    partition_pairs<index_type>(count, [perm](size_t i) { return perm[i]; }, [](size_t i) { return i; },
+                                pairs, bucket_begin, threads);
+    scatter_buckets(pairs, bucket_begin, out, threads);
+}
+
+/// compose_indices() for huge permutations in three streaming passes: partition {rhs[i], i} by source
+/// range, read lhs one cached range at a time while partitioning {i, lhs[rhs[i]]} by destination, then
+/// write every destination range. `scratch` may supply room for 2 * `count` pairs.
+/// Measured on one core it is no faster than compose_indices() up to 6.7 * 10^7 entries.
+template<typename index_type>
+void compose_indices_blocked(const index_type* lhs, const index_type* rhs, index_type* out, size_t count, unsigned threads = 1,
+                             index_pair<index_type>* scratch = nullptr) {
+    if (count == 0) { return; }
+
+    std::unique_ptr<index_pair<index_type>[]> allocated(scratch ? nullptr : new index_pair<index_type>[2 * count]);
+    index_pair<index_type>* by_source = scratch ? scratch : allocated.get();
+    index_pair<index_type>* by_destination = by_source + count;
+
+    std::vector<size_t> bucket_begin;
+    partition_pairs<index_type>(count, [rhs](size_t i) { return rhs[i]; }, [](size_t i) { return i; },
+                                by_source, bucket_begin, threads);
+    partition_pairs<index_type>(count, [by_source](size_t j) { return by_source[j].value; },
+                                [by_source, lhs](size_t j) { return lhs[by_source[j].key]; },
+                                by_destination, bucket_begin, threads);
+    scatter_buckets(by_destination, bucket_begin, out, threads);
+}
+
+/// True when values[0..count) hold every index below `count` exactly once. Marks go into a bitset of
+/// 64-bit words; the range check and the final "all words full" test are branch-free loops that the
+/// compiler vectorizes.
+template<typename value_type>
+bool is_valid_permutation(const value_type* values, size_t count) {
+    const size_t words = (count + 63) / 64;
+    uint64_t inline_marks[8] = {};
+    std::vector<uint64_t> heap_marks(words > 8 ? words : 0);
+    uint64_t* marks = (words > 8) ? heap_marks.data() : inline_marks;
+
+    bool out_of_range = false;
+    for (size_t i = 0; i < count; ++i) {
+        out_of_range |= static_cast<uint64_t>(values[i]) >= count;
+    }
+    if (out_of_range) { return false; }
+
+    for (size_t i = 0; i < count; ++i) {
+        marks[values[i] >> 6] |= uint64_t(1) << (values[i] & 63);
+    }
+
+    /// With all values in range, no duplicates means every bit below `count` is set
+    uint64_t missing = 0;
+    for (size_t w = 0; w + 1 < words; ++w) {
+        missing |= ~marks[w];
+    }
+    if (words > 0) {
+        uint64_t last = (count % 64) ? (uint64_t(1) << (count % 64)) - 1 : ~uint64_t(0);
+        missing |= ~marks[words - 1] & last;
+    }
+
+    return missing == 0;
+}
+
+/// Final mix of MurmurHash3
+inline uint64_t mix_hash(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+/// Hashes `size` bytes eight at a time; permutations hash their compact entries this way
+inline uint64_t hash_bytes(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ size;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t chunk;
+        std::memcpy(&chunk, bytes + i, 8);
+        h = (h ^ mix_hash(chunk)) * 0x9e3779b97f4a7c15ull;
+    }
+    if (i < size) {
+        uint64_t chunk = 0;
+        std::memcpy(&chunk, bytes + i, size - i);
+        h = (h ^ mix_hash(chunk)) * 0x9e3779b97f4a7c15ull;
+    }
+
+    return mix_hash(h);
+}
+
+template<size_t length>
+class packed_permutation;
+
+template<size_t length>
+class permutation;
+
+/// Cycles of a permutation stored back to back in one array, with the offset of each cycle in another
+template<size_t length>
+class cycle_decomposition {
+public:
+    typedef permutation_index_t<length> index_type;
+
+    size_t count() const { return _count; }
+    size_t size(size_t i) const { return _starts.data()[i + 1] - _starts.data()[i]; }
+
+    const index_type* begin(size_t i) const { return _elements.data() + _starts.data()[i]; }
+    const index_type* end(size_t i) const { return _elements.data() + _starts.data()[i + 1]; }
+
+private:
+    friend class permutation<length>;
+
+    permutation_storage<index_type, length> _elements;
+    permutation_storage<permutation_index_t<length + 1>, length + 1> _starts;
+    size_t _count = 0;
+};
+
+template<size_t length>
+class permutation {
+public:
+    typedef permutation_index_t<length> index_type;
+
+    permutation() {
+        for (size_t i = 0; i < length; ++i) {
+            _perm.data()[i] = i;
+        }
+    }
+
+    explicit permutation(const unsigned* array) {
+        for (size_t i = 0; i < length; ++i) {
+            _perm.data()[i] = array[i];
+        }
+    }
+
+    /// Same as the constructor from an array, but throws std::invalid_argument unless `array` is a permutation
+    static permutation checked(const unsigned* array) {
+        if (!is_valid_permutation(array, length)) { throw std::invalid_argument("Error: Array is not a permutation!"); }
+        return permutation(array);
+    }
+
+    permutation(const permutation& other) = default;
+    permutation& operator= (const permutation& other) = default;
+    ~permutation() = default;
+
+    index_type& operator[] (size_t i) { return _perm.data()[i]; }
+    unsigned operator[] (size_t i) const { return _perm.data()[i]; }
+
+    index_type* data() { return _perm.data(); }
+    const index_type* data() const { return _perm.data(); }
+
+    /// Packs the permutation into one 64-bit word, 4 bits per entry
+    packed_permutation<length> pack() const;
+
+    permutation& operator*= (const permutation& other) {
+        permutation_storage<index_type, length> res;
+        compose_indices(_perm.data(), other.data(), res.data(), length);
+
+        _perm.swap(res);
+        return *this;
+    }
+
+    permutation& operator++ () {
+        advance();
+        return *this;
+    }
+
+    permutation& operator-- () {
+        retreat();
+        return *this;
+    }
+
+    const permutation operator++ (int) {
+        permutation tmp = *this;
+        advance();
+        return tmp;
+    }
+
+    const permutation operator-- (int) {
+        permutation tmp = *this;
+        retreat();
+        return tmp;
+    }
+
+    /// Moves values[i] to values[perm[i]] in place, walking each cycle once
+    template<typename value_type>
+    void operator() (value_type* values) const {
+        if constexpr (length * sizeof(index_type) <= PERMUTATION_INLINE_BYTES) {
+            std::bitset<length> visited;
+            apply_cycles(_perm.data(), length, values, visited);
+        } else {
+            std::vector<bool> visited(length);
+            apply_cycles(_perm.data(), length, values, visited);
+        }
+    }
+
+    /// Same as operator(), but never allocates: `scratch` must have room for `length` values
+    template<typename value_type>
+    void operator() (value_type* values, value_type* scratch) const { apply_scatter(_perm.data(), length, values, scratch); }
+
+    /// Steps to the next permutation in lexicographic order in place, see advance_indices()
+    bool advance() { return advance_indices(_perm.data(), length); }
+
+    /// Steps to the previous permutation in place, see retreat_indices()
+    bool retreat() { return retreat_indices(_perm.data(), length); }
+
+    /// Lexicographic index of the permutation among all length! permutations
+    uint64_t rank() const;
+
+    /// The permutation with the given lexicographic index, inverse of rank()
+    static permutation unrank(uint64_t index);
+
+    /// All cycles, fixed points included, each starting from its smallest element
+    cycle_decomposition<length> cycles() const;
+
+    /// Smallest k > 0 with p^k = id, the LCM of the cycle lengths. Throws std::overflow_error above 2^64.
+    uint64_t order() const;
+
+    /// +1 for even permutations, -1 for odd ones
+    int sign() const { return ((length - cycles().count()) % 2) ? -1 : 1; }
+
+    /// p^k, rotating every cycle by k in O(length) regardless of k. Negative k gives powers of the inverse.
+    permutation pow(long long k) const;
+
+    /// Permutations are conjugate exactly when they have the same cycle type
+    bool conjugate_to(const permutation& other) const;
+
+    permutation next() const {
+        permutation<length> res = *this;
+        res.advance();
+        return res;
+    }
+
+    permutation inverse() const {
+        permutation<length> res;
+        invert_indices(_perm.data(), res.data(), length);
+        return res;
+    }
+
+    permutation prev() const {
+        permutation<length> res = *this;
+        res.retreat();
+        return res;
+    }
+
+private:
+    permutation_storage<index_type, length> _perm;
+};
+
+template<size_t length1, size_t length2>
+bool operator<(const permutation<length1> &lhs, const permutation<length2> &rhs) {
+    for (size_t i = 0; (i < length1) && (i < length2); ++i) {
+        if (lhs[i] > rhs[i]) { return false; }
+        else if (lhs[i] < rhs[i]) { return true; }
+    }
+
+    return length1 < length2;
+}
+
+template<size_t length1, size_t length2>
+bool operator==(const permutation<length1> &lhs, const permutation<length2> &rhs) {
+    for (size_t i = 0; (i < length1) && (i < length2); ++i) {
+        if (lhs[i] != rhs[i]) { return false; }
+    }
+
+    return length1 == length2;
+}
+
+template<size_t length1, size_t length2>
+bool operator<= (const permutation<length1> &lhs, const permutation<length2> &rhs) { return (lhs < rhs) || (lhs == rhs); }
+
+template<size_t length1, size_t length2>
+bool operator> (const permutation<length1> &lhs, const permutation<length2> &rhs) { return !(lhs <= rhs); }
+
+template<size_t length1, size_t length2>
+bool operator>= (const permutation<length1> &lhs, const permutation<length2> &rhs) { return !(lhs < rhs); }
+
+template<size_t length1, size_t length2>
+bool operator!= (const permutation<length1> &lhs, const permutation<length2> &rhs) { return !(lhs == rhs); }
+
+template<size_t length>
+permutation<length> operator* (const permutation<length>& first, const permutation<length>& second) {
+    permutation<length> res;
+    compose_indices(first.data(), second.data(), res.data(), length);
+    return res;
+}
+
+
+/// Permutation whose length is only known at run time. Shares its kernels with permutation<length>.
+/// It either owns its entries or lives in a caller-supplied buffer (e.g. mmap'd or arena memory),
+/// which must outlive it and is never freed by it.
+class dynamic_permutation {
+public:
+    typedef uint32_t index_type;
+
+    explicit dynamic_permutation(size_t length = 0): _perm(new index_type[length]), _length(length), _owns(true) {
+        set_identity();
+    }
+
+    dynamic_permutation(size_t length, const unsigned* array): _perm(new index_type[length]), _length(length), _owns(true) {
+        std::copy(array, array + length, _perm);
+    }
+
+    /// Same as the constructor from an array, but throws std::invalid_argument unless `array` is a permutation
+    static dynamic_permutation checked(size_t length, const unsigned* array) {
+        if (!is_valid_permutation(array, length)) { throw std::invalid_argument("Error: Array is not a permutation!"); }
+        return dynamic_permutation(length, array);
+    }
+
+    /// Uses `buffer` of `length` entries as storage; keeps its contents unless `identity` is set
+    dynamic_permutation(size_t length, index_type* buffer, bool identity): _perm(buffer), _length(length), _owns(false) {
+        if (identity) { set_identity(); }
+    }
+
+    template<size_t length>
+    explicit dynamic_permutation(const permutation<length>& other): _perm(new index_type[length]), _length(length), _owns(true) {
+        std::copy(other.data(), other.data() + length, _perm);
+    }
+
+    dynamic_permutation(const dynamic_permutation& other): _perm(new index_type[other._length]), _length(other._length), _owns(true) {
+        std::copy(other._perm, other._perm + _length, _perm);
+    }
+
+    dynamic_permutation(dynamic_permutation&& other) noexcept
+        : _perm(other._perm), _length(other._length), _owns(other._owns), _spare(std::move(other._spare)) {
+        other._perm = nullptr;
+        other._length = 0;
+        other._owns = true;
+    }
+
+    /// A buffer-backed permutation keeps its buffer, so it can only take values of the same length
+    dynamic_permutation& operator= (const dynamic_permutation& other) {
+        if (this != &other) {
+            if (_length != other._length) {
+                if (!_owns) { throw std::length_error("Error: Cannot resize a permutation in a caller buffer!"); }
+
+                delete[] _perm;
+                _perm = new index_type[other._length];
+                _length = other._length;
+                _spare.reset();
+            }
+            std::copy(other._perm, other._perm + _length, _perm);
+        }
+
+        return *this;
+    }
+
+    ~dynamic_permutation() {
+        if (_owns) { delete[] _perm; }
+    }
+
+    index_type& operator[] (size_t i) { return _perm[i]; }
+    unsigned operator[] (size_t i) const { return _perm[i]; }
+
+    size_t size() const { return _length; }
+    index_type* data() { return _perm; }
+    const index_type* data() const { return _perm; }
+
+    /// The product goes to a spare buffer that is allocated on the first call and kept; an owned permutation
+    /// then swaps it in, a buffer-backed one copies it back
+    dynamic_permutation& operator*= (const dynamic_permutation& other) {
+        check_length(other);
+        if (!_spare) { _spare.reset(new index_type[_length]); }
+
+        compose_indices(_perm, other._perm, _spare.get(), _length);
+        if (_owns) {
+            index_type* res = _spare.release();
+            _spare.reset(_perm);
+            _perm = res;
+        } else {
+            std::copy(_spare.get(), _spare.get() + _length, _perm);
+        }
+        return *this;
+    }
+
+    /// Same as operator*=, but never allocates: `scratch` must have room for size() entries
+    dynamic_permutation& multiply(const dynamic_permutation& other, index_type* scratch) {
+        check_length(other);
+        compose_indices(_perm, other._perm, scratch, _length);
+        std::copy(scratch, scratch + _length, _perm);
+        return *this;
+    }
+
+    /// Writes first * second into *this; *this must not be either operand
+    void assign_product(const dynamic_permutation& first, const dynamic_permutation& second) {
+        check_length(first);
+        check_length(second);
+        compose_indices(first._perm, second._perm, _perm, _length);
+    }
+
+    dynamic_permutation& operator++ () {
+        advance();
+        return *this;
+    }
+
+    dynamic_permutation& operator-- () {
+        retreat();
+        return *this;
+    }
+
+    const dynamic_permutation operator++ (int) {
+        dynamic_permutation tmp = *this;
+        advance();
+        return tmp;
+    }
+
+    const dynamic_permutation operator-- (int) {
+        dynamic_permutation tmp = *this;
+        retreat();
+        return tmp;
+    }
+
+    /// Moves values[i] to values[perm[i]] in place, see apply_cycles()
+    template<typename value_type>
+    void operator() (value_type* values) const {
+        std::vector<bool> visited(_length);
+        apply_cycles(_perm, _length, values, visited);
+    }
+
+    /// Same as operator(), but never allocates: `scratch` must have room for size() values
+    template<typename value_type>
+    void operator() (value_type* values, value_type* scratch) const { apply_scatter(_perm, _length, values, scratch); }
+
+    bool advance() { return advance_indices(_perm, _length); }
+    bool retreat() { return retreat_indices(_perm, _length); }
+
+    dynamic_permutation next() const {
+        dynamic_permutation res = *this;
+        res.advance();
+        return res;
+    }
+
+    dynamic_permutation prev() const {
+        dynamic_permutation res = *this;
+        res.retreat();
+        return res;
+    }
+
+    dynamic_permutation inverse() const {
+        dynamic_permutation res(_length, uninitialized());
+        invert_indices(_perm, res._perm, _length);
+        return res;
+    }
+
+    friend dynamic_permutation operator* (const dynamic_permutation& first, const dynamic_permutation& second);
+
+private:
+    /// Marks the constructor that leaves the entries for the caller to fill
+    struct uninitialized {};
+
+    dynamic_permutation(size_t length, uninitialized): _perm(new index_type[length]), _length(length), _owns(true) {}
+
+    void set_identity() {
+        for (size_t i = 0; i < _length; ++i) {
+            _perm[i] = i;
+        }
+    }
+
+    void check_length(const dynamic_permutation& other) const {
+        if (_length != other._length) {
+            throw std::length_error("Error: Cannot compose permutations of lengths " + std::to_string(_length) + " and " + std::to_string(other._length));
+        }
+    }
+
+    index_type* _perm;
+    size_t _length;
+    bool _owns;
+    /// Target of operator*=, kept between calls
+    std::unique_ptr<index_type[]> _spare;
+};
+
+bool operator< (const dynamic_permutation& lhs, const dynamic_permutation& rhs) {
+    return std::lexicographical_compare(lhs.data(), lhs.data() + lhs.size(), rhs.data(), rhs.data() + rhs.size());
+}
+
+bool operator== (const dynamic_permutation& lhs, const dynamic_permutation& rhs) {
+    return lhs.size() == rhs.size() && std::equal(lhs.data(), lhs.data() + lhs.size(), rhs.data());
+}
+
+bool operator<= (const dynamic_permutation& lhs, const dynamic_permutation& rhs) { return !(rhs < lhs); }
+bool operator> (const dynamic_permutation& lhs, const dynamic_permutation& rhs) { return rhs < lhs; }
+bool operator>= (const dynamic_permutation& lhs, const dynamic_permutation& rhs) { return !(lhs < rhs); }
+bool operator!= (const dynamic_permutation& lhs, const dynamic_permutation& rhs) { return !(lhs == rhs); }
+
+dynamic_permutation operator* (const dynamic_permutation& first, const dynamic_permutation& second) {
+    dynamic_permutation res(first.size(), dynamic_permutation::uninitialized());
+    res.assign_product(first, second);
+    return res;
+}
+
+
+/// Permutation of at most 16 elements packed into a single 64-bit word, entry i in bits [4i, 4i + 4).
+/// Unused entries above `length` hold their own index, so composition never leaves the word.
+template<size_t length>
+class packed_permutation {
+    static_assert(length <= 16, "Only permutations of at most 16 elements fit into 64 bits");
+
+public:
+    packed_permutation(): _word(IDENTITY) {}
+    explicit packed_permutation(uint64_t word): _word(word) {}
+
+    unsigned operator[] (size_t i) const { return (_word >> (4 * i)) & 0xf; }
+    uint64_t word() const { return _word; }
+
+    /// (this * other)[i] = this[other[i]], same as permutation::operator*=
+    packed_permutation& operator*= (const packed_permutation& other) {
+#if defined(__SSSE3__)
+        _word = pack_bytes(_mm_shuffle_epi8(unpack_bytes(_word), unpack_bytes(other._word)));
+#else
+        uint64_t res = 0;
+        for (size_t i = 0; i < 16; ++i) {
+            res |= static_cast<uint64_t>((*this)[other[i]]) << (4 * i);
+        }
+        _word = res;
+#endif
+        return *this;
+    }
+
+    permutation<length> unpack() const {
+        permutation<length> res;
+        for (size_t i = 0; i < length; ++i) {
+            res[i] = (*this)[i];
+        }
+
+        return res;
+    }
+
+private:
+    static const uint64_t IDENTITY = 0xfedcba9876543210ull;
+
+#if defined(__SSSE3__)
+    /// One nibble per byte: byte i = entry i
+    static __m128i unpack_bytes(uint64_t word) {
+        const __m128i low_nibbles = _mm_set1_epi8(0x0f);
+        __m128i bytes = _mm_cvtsi64_si128(static_cast<long long>(word));
+        __m128i lo = _mm_and_si128(bytes, low_nibbles);
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), low_nibbles);
+        return _mm_unpacklo_epi8(lo, hi);
+    }
+
+    static uint64_t pack_bytes(__m128i bytes) {
+        __m128i merged = _mm_or_si128(bytes, _mm_srli_epi16(bytes, 4));
+        merged = _mm_and_si128(merged, _mm_set1_epi16(0x00ff));
+        return static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_packus_epi16(merged, merged)));
+    }
+#endif
+
+    uint64_t _word;
+};
+
+template<size_t length>
+packed_permutation<length> operator* (const packed_permutation<length>& first, const packed_permutation<length>& second) {
+    return packed_permutation<length>(first) *= second;
+}
+
+template<size_t length>
+bool operator== (const packed_permutation<length>& lhs, const packed_permutation<length>& rhs) { return lhs.word() == rhs.word(); }
+
+template<size_t length>
+bool operator!= (const packed_permutation<length>& lhs, const packed_permutation<length>& rhs) { return !(lhs == rhs); }
+
+template<size_t length>
+packed_permutation<length> permutation<length>::pack() const {
+    static_assert(length <= 16, "Only permutations of at most 16 elements fit into 64 bits");
+
+    uint64_t word = packed_permutation<length>().word();
+    for (size_t i = 0; i < length; ++i) {
+        word &= ~(0xfull << (4 * i));
+        word |= static_cast<uint64_t>(_perm.data()[i]) << (4 * i);
+    }
+
+    return packed_permutation<length>(word);
+}
+
+
+template<size_t length>
+cycle_decomposition<length> permutation<length>::cycles() const {
+    cycle_decomposition<length> res;
+    size_t filled = 0;
+
+    auto collect = [&](auto& visited) {
+        for (size_t i = 0; i < length; ++i) {
+            if (visited[i]) { continue; }
+
+            res._starts.data()[res._count++] = filled;
+            for (size_t j = i; !visited[j]; j = _perm.data()[j]) {
+                visited[j] = true;
+                res._elements.data()[filled++] = j;
+            }
+        }
+        res._starts.data()[res._count] = filled;
+    };
+
+    if constexpr (length * sizeof(index_type) <= PERMUTATION_INLINE_BYTES) {
+        std::bitset<length> visited;
+        collect(visited);
+    } else {
+        std::vector<bool> visited(length);
+        collect(visited);
+    }
+
+    return res;
+}
+
+template<size_t length>
+uint64_t permutation<length>::order() const {
+    cycle_decomposition<length> decomposition = cycles();
+
+    uint64_t res = 1;
+    for (size_t i = 0; i < decomposition.count(); ++i) {
+        uint64_t cycle = decomposition.size(i);
+        uint64_t a = res, b = cycle;
+        while (b != 0) { a = std::exchange(b, a % b); }
+
+        if (__builtin_mul_overflow(res / a, cycle, &res)) {
+            throw std::overflow_error("Error: Permutation order does not fit into 64 bits!");
+        }
+    }
+
+    return res;
+}
+
+template<size_t length>
+permutation<length> permutation<length>::pow(long long k) const {
+    cycle_decomposition<length> decomposition = cycles();
+
+    permutation res;
+    for (size_t i = 0; i < decomposition.count(); ++i) {
+        const index_type* cycle = decomposition.begin(i);
+        long long size = decomposition.size(i);
+        size_t shift = ((k % size) + size) % size;
+
+        for (size_t j = 0, target = shift; j < static_cast<size_t>(size); ++j) {
+            res[cycle[j]] = cycle[target];
+            if (++target == static_cast<size_t>(size)) { target = 0; }
+        }
+    }
+
+    return res;
+}
+
+template<size_t length>
+bool permutation<length>::conjugate_to(const permutation& other) const {
+    typedef permutation_index_t<length + 1> count_type;
+
+    auto cycle_type = [](const cycle_decomposition<length>& decomposition) {
+        permutation_storage<count_type, length + 1> counts;
+        std::fill(counts.data(), counts.data() + length + 1, 0);
+        for (size_t i = 0; i < decomposition.count(); ++i) {
+            ++counts.data()[decomposition.size(i)];
+        }
+        return counts;
+    };
+
+    auto lhs = cycle_type(cycles());
+    auto rhs = cycle_type(other.cycles());
+    return std::equal(lhs.data(), lhs.data() + length + 1, rhs.data());
+}
+
+
+/// n! for every n whose factorial fits into 64 bits
+constexpr uint64_t factorial(size_t n) { return n <= 1 ? 1 : n * factorial(n - 1); }
+
+const size_t MAX_RANKED_LENGTH = 20;
+
+/// Ranks use the Lehmer code; the unused values are kept as a bitmask, so counting the unused values
+/// below v is a popcount and finding the k-th unused value is a bit select, O(n) overall.
+template<size_t length>
+uint64_t permutation<length>::rank() const {
+    static_assert(length <= MAX_RANKED_LENGTH, "Ranks of longer permutations do not fit into 64 bits");
+
+    uint32_t used = 0;
+    uint64_t res = 0;
+    for (size_t i = 0; i < length; ++i) {
+        unsigned value = _perm.data()[i];
+        unsigned smaller_unused = value - __builtin_popcount(used & ((1u << value) - 1));
+        res += smaller_unused * factorial(length - 1 - i);
+        used |= 1u << value;
+    }
+
+    return res;
+}
+
+template<size_t length>
+permutation<length> permutation<length>::unrank(uint64_t index) {
+    static_assert(length <= MAX_RANKED_LENGTH, "Ranks of longer permutations do not fit into 64 bits");
+
+    if (index >= factorial(length)) {
+        throw std::out_of_range("Error: Rank " + std::to_string(index) + " is out of range for length " + std::to_string(length) + "!");
+    }
+
+    permutation res;
+    uint32_t unused = (1u << length) - 1;
+    for (size_t i = 0; i < length; ++i) {
+        uint64_t weight = factorial(length - 1 - i);
+        unsigned k = index / weight;
+        index %= weight;
+
+#if defined(__BMI2__)
+        unsigned value = __builtin_ctz(_pdep_u32(1u << k, unused));
+#else
+        uint32_t rest = unused;
+        for (unsigned j = 0; j < k; ++j) {
+            rest &= rest - 1;
+        }
+        unsigned value = __builtin_ctz(rest);
+#endif
+        res[i] = value;
+        unused &= ~(1u << value);
+    }
+
+    return res;
+}
+
+/// Start of block t when [0, total) is cut into `parts` contiguous blocks whose sizes differ by at most one.
+/// total * t / parts would overflow for ranges as large as 20!.
+constexpr uint64_t block_start(uint64_t total, uint64_t parts, uint64_t t) {
+    return total / parts * t + std::min(t, total % parts);
+}
+
+constexpr bool blocks_cover(uint64_t total, uint64_t parts) {
+    for (uint64_t t = 0; t < parts; ++t) {
+        if (block_start(total, parts, t) > block_start(total, parts, t + 1)) { return false; }
+    }
+    return block_start(total, parts, 0) == 0 && block_start(total, parts, parts) == total;
+}
+
+static_assert(blocks_cover(factorial(MAX_RANKED_LENGTH), 8) && blocks_cover(factorial(MAX_RANKED_LENGTH), 64)
+              && blocks_cover(factorial(MAX_RANKED_LENGTH), 1000), "Blocks must cover the whole rank range");
+
+/// Calls fn(const permutation<length>&) for every permutation with rank in [begin_rank, end_rank).
+/// The range is cut into contiguous lexicographic blocks, one per thread; each thread starts from
+/// unrank() and then steps with advance(). `fn` must be safe to call concurrently.
+template<size_t length, typename function>
+void for_each_permutation(uint64_t begin_rank, uint64_t end_rank, function fn,
+                          unsigned threads = std::thread::hardware_concurrency()) {
+    end_rank = std::min(end_rank, factorial(length));
+    if (begin_rank >= end_rank) { return; }
+
+    uint64_t total = end_rank - begin_rank;
+    threads = static_cast<unsigned>(std::max<uint64_t>(1, std::min<uint64_t>(threads, total)));
+
+    run_parallel(threads, [&](unsigned t) {
+        uint64_t first = begin_rank + block_start(total, threads, t);
+        uint64_t last = begin_rank + block_start(total, threads, t + 1);
+
+        permutation<length> perm = permutation<length>::unrank(first);
+        for (uint64_t r = first; r < last; ++r) {
+            fn(static_cast<const permutation<length>&>(perm));
+            perm.advance();
+        }
+    });
+}
+
+
+namespace std {
+    template<size_t length>
+    struct hash<permutation<length>> {
+        size_t operator() (const permutation<length>& perm) const {
+            return hash_bytes(perm.data(), length * sizeof(typename permutation<length>::index_type));
+        }
+    };
+
+    template<size_t length>
+    struct hash<packed_permutation<length>> {
+        size_t operator() (const packed_permutation<length>& perm) const { return mix_hash(perm.word()); }
+    };
+
+    template<>
+    struct hash<dynamic_permutation> {
+        size_t operator() (const dynamic_permutation& perm) const {
+            return hash_bytes(perm.data(), perm.size() * sizeof(dynamic_permutation::index_type));
+        }
+    };
+}
+
+/// Open-addressing set of permutation<length> for deduplication. Entries are stored back to back in
+/// one array of compact indices, next to an array of their hashes (0 marks an empty slot), and probed
+/// linearly, so a lookup compares hashes first and entries only on a hash match.
+template<size_t length>
+class permutation_set {
+public:
+    typedef typename permutation<length>::index_type index_type;
+
+    explicit permutation_set(size_t expected = 0): _size(0) { rehash(capacity_for(expected)); }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    /// Returns false if the permutation was already present
+    bool insert(const permutation<length>& perm) {
+        if ((_size + 1) * 8 > _hashes.size() * 7) { rehash(_hashes.size() * 2); }
+
+        uint64_t h = slot_hash(perm);
+        size_t slot = find(perm, h);
+        if (_hashes[slot] != 0) { return false; }
+
+        _hashes[slot] = h;
+        std::copy(perm.data(), perm.data() + length, _entries.data() + slot * length);
+        ++_size;
+        return true;
+    }
+
+    bool contains(const permutation<length>& perm) const {
+        uint64_t h = slot_hash(perm);
+        return _hashes[find(perm, h)] != 0;
+    }
+
+    /// Calls fn(const index_type*) for the entries of every stored permutation
+    template<typename function>
+    void for_each(function fn) const {
+        for (size_t slot = 0; slot < _hashes.size(); ++slot) {
+            if (_hashes[slot] != 0) { fn(static_cast<const index_type*>(_entries.data() + slot * length)); }
+        }
+    }
+
+private:
+    static size_t capacity_for(size_t expected) {
+        size_t capacity = 16;
+        while (capacity * 7 < expected * 8) { capacity *= 2; }
+        return capacity;
+    }
+
+    static uint64_t slot_hash(const permutation<length>& perm) {
+        uint64_t h = std::hash<permutation<length>>()(perm);
+        return h ? h : 1;
+    }
+
+    /// Slot holding `perm`, or the empty slot where it would go
+    size_t find(const permutation<length>& perm, uint64_t h) const {
+        size_t mask = _hashes.size() - 1;
+        for (size_t slot = h & mask;; slot = (slot + 1) & mask) {
+            if (_hashes[slot] == 0) { return slot; }
+            if (_hashes[slot] == h && std::equal(perm.data(), perm.data() + length, _entries.data() + slot * length)) {
+                return slot;
+            }
+        }
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<uint64_t> hashes(capacity, 0);
+        std::vector<index_type> entries(capacity * length);
+
+        size_t mask = capacity - 1;
+        for (size_t old = 0; old < _hashes.size(); ++old) {
+            if (_hashes[old] == 0) { continue; }
+
+            size_t slot = _hashes[old] & mask;
+            while (hashes[slot] != 0) { slot = (slot + 1) & mask; }
+            hashes[slot] = _hashes[old];
+            std::copy(_entries.data() + old * length, _entries.data() + (old + 1) * length, entries.data() + slot * length);
+        }
+
+        _hashes.swap(hashes);
+        _entries.swap(entries);
+    }
+
+    std::vector<uint64_t> _hashes;
+    std::vector<index_type> _entries;
+    size_t _size;
+};
+
+
+/// Enumerates all permutations with Heap's algorithm: consecutive permutations differ by a single
+/// transposition, so state derived from the permutation can be updated incrementally.
+///     heap_walker<n> walker;
+///     size_t i, j;
+///     do { use(walker.current()); } while (walker.step(i, j));
+template<size_t length>
+class heap_walker {
+public:
+    typedef typename permutation<length>::index_type index_type;
+
+    explicit heap_walker(const permutation<length>& start = permutation<length>()): _perm(start), _level(1) {
+        std::fill(_counters.data(), _counters.data() + length, 0);
+    }
+
+    const permutation<length>& current() const { return _perm; }
+
+    /// Swaps two positions of the current permutation and reports them through `first` and `second`.
+    /// Returns false once all length! permutations have been visited.
+    bool step(size_t& first, size_t& second) {
+        index_type* counters = _counters.data();
+
+        while (_level < length && counters[_level] >= _level) {
+            counters[_level] = 0;
+            ++_level;
+        }
+
+        if (_level >= length) { return false; }
+
+        first = (_level % 2) ? counters[_level] : 0;
+        second = _level;
+        std::swap(_perm[first], _perm[second]);
+
+        ++counters[_level];
+        _level = 1;
+        return true;
+    }
+
+private:
+    permutation<length> _perm;
+    permutation_storage<index_type, length> _counters;
+    size_t _level;
+};
+
+
+#ifndef CPP_NO_MAIN
+int main() {
+    permutation<3> A;
+
+    for (int i = 0; i < 3; ++i) {
+        std::cout << +A[i] << " ";
+    }
+    std::cout << std::endl;
+
+    --A;
+
+    for (int i = 0; i < 3; ++i) {
+        std::cout << +A[i] << " ";
+    }
+
+    return 0;
+}
+#endif //CPP_NO_MAIN